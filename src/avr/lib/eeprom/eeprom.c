@@ -70,6 +70,40 @@ Configuration_t loadConfig(void) {
   if (config.main.version < 15) {
     config.debounce.combinedStrum = false;
   }
+  if (config.main.version < 16) {
+    config.debounce.mode = DEBOUNCE_LOCKOUT;
+  }
+  if (config.main.version < 17) {
+    memcpy_P(&config.filter, &default_config.filter,
+             sizeof(default_config.filter));
+  }
+  if (config.main.version < 18) {
+    memcpy_P(&config.curves, &default_config.curves,
+             sizeof(default_config.curves));
+  }
+  if (config.main.version < 19) {
+    config.analogDetectThreshold = ANALOG_DETECT_THRESHOLD;
+  }
+  if (config.main.version < 20) {
+    memcpy_P(&config.shiftRegister, &default_config.shiftRegister,
+             sizeof(default_config.shiftRegister));
+  }
+  if (config.main.version < 21) {
+    memcpy_P(&config.mux, &default_config.mux, sizeof(default_config.mux));
+  }
+  if (config.main.version < 22) {
+    memcpy_P(&config.matrix, &default_config.matrix,
+             sizeof(default_config.matrix));
+  }
+  if (config.main.version < 23) {
+    memcpy_P(&config.encoder, &default_config.encoder,
+             sizeof(default_config.encoder));
+  }
+  if (config.main.version < 24) { config.neck = NO_NECK; }
+  if (config.main.version < 25) {
+    memcpy_P(&config.mpu6050, &default_config.mpu6050,
+             sizeof(default_config.mpu6050));
+  }
   if (config.main.version < CONFIG_VERSION) {
     config.main.version = CONFIG_VERSION;
     eeprom_update_block(&config, &config_pointer, sizeof(Configuration_t));
@@ -52,6 +52,16 @@ static volatile uint8_t twi_error;
 // === MODIFIED ===
 static uint16_t TIMEOUT = 32767;
 
+// Queued transactions are driven from the TWI interrupt. The wait between
+// writing the pointer and reading uses compare B of timer 0, which is already
+// running for millis and ticks every 64 clock cycles.
+#define TWI_ASYNC_IDLE 0
+#define TWI_ASYNC_WRITE 1
+#define TWI_ASYNC_WAIT 2
+#define TWI_ASYNC_READ 3
+static volatile uint8_t twi_asyncPhase = TWI_ASYNC_IDLE;
+static TwiTransaction_t *twi_async;
+
 /*
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -97,6 +107,14 @@ void twi_init(void) {
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
 }
 
+void twi_setFrequency(uint32_t frequency) {
+  // See the bit rate formula above, TWBR still needs to be 10 or higher
+  uint32_t twbr = ((F_CPU / frequency) - 16) / 2;
+  if (twbr < 10) { twbr = 10; }
+  if (twbr > 255) { twbr = 255; }
+  TWBR = twbr;
+}
+
 /*
  * Function twi_disable
  * Desc     disables twi pins
@@ -134,10 +152,10 @@ bool twi_readFrom(uint8_t address, uint8_t *data, uint8_t length,
   // === MODIFIED ===
   // wait until twi is ready, become master receiver
   if (TIMEOUT == 0) {
-    while (TWI_READY != twi_state) continue;
+    while (TWI_READY != twi_state || twi_asyncPhase) continue;
   } else {
     timeoutCounter = TIMEOUT;
-    while (TWI_READY != twi_state) {
+    while (TWI_READY != twi_state || twi_asyncPhase) {
       //_delay_ms( TIMEOUT_TICK );
       timeoutCounter--;
       if (timeoutCounter == 0) return 0;
@@ -252,10 +270,10 @@ bool twi_writeTo(uint8_t address, uint8_t *data, uint8_t length,
   uint16_t timeoutCounter;
   // wait until twi is ready, become master transmitter
   if (TIMEOUT == 0) {
-    while (TWI_READY != twi_state) continue;
+    while (TWI_READY != twi_state || twi_asyncPhase) continue;
   } else {
     timeoutCounter = TIMEOUT;
-    while (TWI_READY != twi_state) {
+    while (TWI_READY != twi_state || twi_asyncPhase) {
       //_delay_ms( TIMEOUT_TICK );
       timeoutCounter--;
       if (timeoutCounter == 0) return false;
@@ -407,6 +425,65 @@ void twi_releaseBus(void) {
   twi_state = TWI_READY;
 }
 
+// Start a transfer without waiting for it. Queued transactions always end
+// with a stop, so there is never a repeated start to deal with.
+static void twi_startAsync(uint8_t slarw, uint8_t length) {
+  twi_state = (slarw & TW_READ) ? TWI_MRX : TWI_MTX;
+  twi_sendStop = true;
+  twi_error = 0xFF;
+  twi_masterBufferIndex = 0;
+  // See twi_readFrom for why reads are one shorter
+  twi_masterBufferLength = (slarw & TW_READ) ? length - 1 : length;
+  twi_slarw = slarw;
+  TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+}
+static void twi_startAsyncRead(void) {
+  twi_asyncPhase = TWI_ASYNC_READ;
+  twi_startAsync(TW_READ | twi_async->address << 1, twi_async->length);
+}
+void twi_startTransaction(TwiTransaction_t *transaction) {
+  uint8_t oldSREG = SREG;
+  cli();
+  twi_async = transaction;
+  twi_asyncPhase = TWI_ASYNC_WRITE;
+  twi_masterBuffer[0] = transaction->pointer;
+  twi_startAsync(TW_WRITE | transaction->address << 1, 1);
+  SREG = oldSREG;
+}
+// Called from the TWI interrupt once the bus has been released
+static void twi_stepAsync(void) {
+  if (twi_asyncPhase == TWI_ASYNC_WRITE) {
+    if (twi_error != 0xFF) {
+      twi_asyncPhase = TWI_ASYNC_IDLE;
+      twi_finishTransaction(false);
+      return;
+    }
+    uint32_t ticks =
+        (uint32_t)twi_async->delayMicros * clockCyclesPerMicrosecond() / 64;
+    if (!ticks) {
+      twi_startAsyncRead();
+      return;
+    }
+    // The timer can only wait for one overflow, around 1ms at 16MHz
+    if (ticks > 255) { ticks = 255; }
+    twi_asyncPhase = TWI_ASYNC_WAIT;
+    OCR0B = TCNT0 + ticks;
+    TIFR0 = _BV(OCF0B);
+    sbi(TIMSK0, OCIE0B);
+  } else if (twi_asyncPhase == TWI_ASYNC_READ) {
+    bool success = twi_masterBufferIndex >= twi_async->length;
+    if (success) {
+      memcpy(twi_async->data, twi_masterBuffer, twi_async->length);
+    }
+    twi_asyncPhase = TWI_ASYNC_IDLE;
+    twi_finishTransaction(success);
+  }
+}
+ISR(TIMER0_COMPB_vect) {
+  cbi(TIMSK0, OCIE0B);
+  twi_startAsyncRead();
+}
+
 ISR(TWI_vect) {
   switch (TW_STATUS) {
   // All Master
@@ -490,4 +567,5 @@ ISR(TWI_vect) {
     twi_stop();
     break;
   }
+  if (twi_state == TWI_READY && twi_asyncPhase) { twi_stepAsync(); }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pins/pins.h"
 #include "eeprom/eeprom.h"
 #include "stddef.h"
+#include "timer/timer.h"
 #include "util/util.h"
 #include <avr/interrupt.h>
 // On the ATmega1280, the addresses of some of the port registers are
@@ -26,8 +27,30 @@ extern const uint8_t PROGMEM analog_pin_to_channel_PGM[];
 #define portModeRegister(P)                                                    \
   ((volatile uint8_t *)(pgm_read_word(port_to_mode_PGM + (P))))
 int validAnalog = 0;
-int currentAnalog = 0;
+volatile uint8_t currentAnalog = 0;
 bool first = true;
+// The ADC interrupt fills one buffer while tickAnalog reads the other. The
+// buffers are swapped after every full pass over joyData, and adcSequence is
+// incremented, so its low bit is always the buffer that is safe to read.
+volatile int16_t adcSamples[2][MAX_ANALOG_INPUTS];
+volatile uint8_t adcSequence = 0;
+// The ADC samples its input 1.5 ADC clocks (12us at 125KHz) after a
+// conversion is started. A multiplexer that takes longer than that to settle
+// gets a conversion that is thrown away first.
+#define ADC_SAMPLE_DELAY_US 12
+MuxConfig_t mux;
+volatile bool adcDiscard = false;
+typedef struct {
+  uint8_t port;
+  uint8_t mask;
+  uint16_t button;
+} ScannedPin_t;
+volatile uint8_t *scannedPorts[XBOX_BTN_COUNT];
+// Pins that are pressed when low are flipped, so that a set bit is a press
+uint8_t scannedPortInvert[XBOX_BTN_COUNT];
+uint8_t scannedPortCount;
+ScannedPin_t scannedPins[XBOX_BTN_COUNT];
+uint8_t scannedPinCount;
 Pin_t setUpDigital(Configuration_t *config, uint8_t pinNum, uint8_t offset,
                    bool inverted, bool output) {
   Pin_t pin = {};
@@ -54,6 +77,99 @@ bool digitalReadPin(Pin_t pin) {
   return info.value > info.threshold;
 }
 
+void setUpPortScan(Pin_t *pins, uint8_t count) {
+  scannedPortCount = 0;
+  scannedPinCount = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    Pin_t pin = pins[i];
+    uint8_t port = 0;
+    while (port < scannedPortCount && scannedPorts[port] != pin.port) {
+      port++;
+    }
+    if (port == scannedPortCount) {
+      scannedPorts[scannedPortCount] = pin.port;
+      scannedPortInvert[scannedPortCount++] = 0;
+    }
+    if (!pin.eq) { scannedPortInvert[port] |= pin.mask; }
+    scannedPins[scannedPinCount++] =
+        (ScannedPin_t){port, pin.mask, _BV(pin.offset)};
+  }
+}
+uint16_t readPortScan(void) {
+  uint8_t snapshot[XBOX_BTN_COUNT];
+  for (uint8_t i = 0; i < scannedPortCount; i++) {
+    snapshot[i] = *scannedPorts[i] ^ scannedPortInvert[i];
+  }
+  uint16_t ret = 0;
+  ScannedPin_t *pin = scannedPins;
+  for (uint8_t i = 0; i < scannedPinCount; i++, pin++) {
+    if (snapshot[pin->port] & pin->mask) { ret |= pin->button; }
+  }
+  return ret;
+}
+
+typedef struct {
+  uint8_t port;
+  uint8_t mask;
+  uint8_t snapshot;
+} DetectPort_t;
+// No supported board has more than 12 ports
+DetectPort_t detectPorts[12];
+uint8_t detectPortCount;
+void startPinDetection(bool (*skip)(uint8_t pin)) {
+  detectPortCount = 0;
+  for (uint8_t i = 0; i < NUM_DIGITAL_PINS; i++) {
+    if (skip(i)) continue;
+    uint8_t port = digitalPinToPort(i);
+    uint8_t j = 0;
+    while (j < detectPortCount && detectPorts[j].port != port) { j++; }
+    if (j == detectPortCount) {
+      detectPorts[detectPortCount++] = (DetectPort_t){port, 0, 0};
+    }
+    detectPorts[j].mask |= digitalPinToBitMask(i);
+  }
+  // Turn on the pullups for a whole port at a time, so that every pin only
+  // has to wait for the same delay
+  uint8_t oldSREG = SREG;
+  cli();
+  for (uint8_t j = 0; j < detectPortCount; j++) {
+    DetectPort_t *port = &detectPorts[j];
+    *portModeRegister(port->port) &= ~port->mask;
+    *portOutputRegister(port->port) |= port->mask;
+  }
+  SREG = oldSREG;
+  _delay_us(100);
+  for (uint8_t j = 0; j < detectPortCount; j++) {
+    DetectPort_t *port = &detectPorts[j];
+    port->snapshot = *portInputRegister(port->port) & port->mask;
+  }
+}
+uint8_t findChangedPin(void) {
+  for (uint8_t j = 0; j < detectPortCount; j++) {
+    DetectPort_t *port = &detectPorts[j];
+    uint8_t changed =
+        (*portInputRegister(port->port) ^ port->snapshot) & port->mask;
+    if (!changed) continue;
+    for (uint8_t i = 0; i < NUM_DIGITAL_PINS; i++) {
+      if (digitalPinToPort(i) == port->port &&
+          (digitalPinToBitMask(i) & changed)) {
+        return i;
+      }
+    }
+  }
+  return INVALID_PIN;
+}
+void stopPinDetection(void) {
+  uint8_t oldSREG = SREG;
+  cli();
+  for (uint8_t j = 0; j < detectPortCount; j++) {
+    DetectPort_t *port = &detectPorts[j];
+    *portOutputRegister(port->port) &= ~port->mask;
+  }
+  SREG = oldSREG;
+  detectPortCount = 0;
+}
+
 void digitalWritePin(Pin_t pin, bool value) {
   if (value == 0) {
     *pin.port &= ~pin.mask;
@@ -101,6 +217,12 @@ void setUpAnalogPin(Configuration_t *config, uint8_t offset) {
   if (offset == 5 && typeIsGuitar && config->main.tiltType != ANALOGUE) {
     return;
   }
+  ret.muxChannel = INVALID_PIN;
+  if (isMuxPin(pin)) {
+    if (mux.pin == INVALID_PIN) { return; }
+    ret.muxChannel = pin - MUX_PIN_BASE;
+    pin = mux.pin;
+  }
 
   pinMode(pin, INPUT);
   ret.hasDigital = false;
@@ -114,9 +236,15 @@ void setUpAnalogPin(Configuration_t *config, uint8_t offset) {
 }
 void setUpAnalogDigitalPin(Pin_t *button, uint8_t pin, uint16_t threshold) {
   AnalogInfo_t ret = {0};
-  ret.offset = pin;
+  ret.offset = button->offset;
   ret.hasDigital = true;
   ret.threshold = threshold;
+  ret.muxChannel = INVALID_PIN;
+  if (isMuxPin(pin)) {
+    if (mux.pin == INVALID_PIN) { return; }
+    ret.muxChannel = pin - MUX_PIN_BASE;
+    pin = mux.pin;
+  }
   pinMode(pin, INPUT);
   pin -= PIN_A0;
 #if defined(analogPinToChannel)
@@ -127,41 +255,86 @@ void setUpAnalogDigitalPin(Pin_t *button, uint8_t pin, uint16_t threshold) {
   ret.pin = pin;
   joyData[validAnalog++] = ret;
 }
-void tickAnalog(void) {
-  if (validAnalog == 0) return;
-  if (!first) {
-    if (bit_is_set(ADCSRA, ADSC)) return;
-    uint8_t low, high;
-    low = ADCL;
-    high = ADCH;
-    int16_t data = (high << 8) | low;
-    AnalogInfo_t *info = &joyData[currentAnalog];
-    if (!info->hasDigital) {
-      data = data - 512;
-      if (info->inverted) data = -data;
+void setUpMux(Configuration_t *config) {
+  mux = config->mux;
+  if (mux.pin == INVALID_PIN) { return; }
+  for (uint8_t i = 0; i < sizeof(mux.select); i++) {
+    if (mux.select[i] != INVALID_PIN) { pinMode(mux.select[i], OUTPUT); }
+  }
+}
+static inline void startConversion(AnalogInfo_t *info) {
+  uint8_t pin = info->pin;
+  if (info->muxChannel != INVALID_PIN) {
+    for (uint8_t i = 0; i < sizeof(mux.select); i++) {
+      if (mux.select[i] != INVALID_PIN) {
+        digitalWrite(mux.select[i], bit_check(info->muxChannel, i));
+      }
     }
-    data = data * 64;
-    info->value = data;
-    currentAnalog++;
-    if (currentAnalog == validAnalog) { currentAnalog = 0; }
+    adcDiscard = mux.settleMicros > ADC_SAMPLE_DELAY_US;
   }
-  first = false;
-  AnalogInfo_t info = joyData[currentAnalog];
-
 #if defined(ADCSRB) && defined(MUX5)
   // the MUX5 bit of ADCSRB selects whether we're reading from channels
   // 0 to 7 (MUX5 low) or 8 to 15 (MUX5 high).
-  ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((info.pin >> 3) & 0x01) << MUX5);
+  ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((pin >> 3) & 0x01) << MUX5);
 #endif
 
   // set the analog reference (high two bits of ADMUX) and select the
   // channel (low 4 bits).  this also sets ADLAR (left-adjust result)
   // to 0 (the default).
 
-  ADMUX = (1 << 6) | (info.pin & 0x07);
+  ADMUX = (1 << 6) | (pin & 0x07);
 
   sbi(ADCSRA, ADSC);
 }
+// Each time a conversion finishes, store it and start converting the next pin,
+// so that all pins are scanned without any help from the main loop.
+ISR(ADC_vect) {
+  if (adcDiscard) {
+    // The multiplexer has settled by now, so convert the same pin again
+    adcDiscard = false;
+    sbi(ADCSRA, ADSC);
+    return;
+  }
+  uint8_t current = currentAnalog;
+  uint8_t back = (adcSequence & 1) ^ 1;
+  int16_t data = ADC;
+  AnalogInfo_t *info = &joyData[current];
+  if (!info->hasDigital) {
+    data = data - 512;
+    if (info->inverted) data = -data;
+  }
+  adcSamples[back][current] = data * 64;
+  current++;
+  if (current == validAnalog) {
+    current = 0;
+    adcSequence++;
+  }
+  currentAnalog = current;
+  startConversion(&joyData[current]);
+}
+void tickAnalog(void) {
+  if (validAnalog == 0) return;
+  if (first) {
+    first = false;
+    currentAnalog = 0;
+    // analogRead may have left the interrupt flag set, and that result would
+    // be stored against the wrong pin.
+    sbi(ADCSRA, ADIF);
+    sbi(ADCSRA, ADIE);
+    startConversion(&joyData[0]);
+    return;
+  }
+  // If the buffers were swapped while copying, the copy may be a mix of two
+  // passes, so try again.
+  uint8_t sequence;
+  do {
+    sequence = adcSequence;
+    volatile int16_t *samples = adcSamples[sequence & 1];
+    for (uint8_t i = 0; i < validAnalog; i++) {
+      joyData[i].value = samples[i];
+    }
+  } while (sequence != adcSequence);
+}
 
 uint16_t analogRead(uint8_t pin) {
   uint8_t low, high;
@@ -228,6 +401,7 @@ uint16_t analogRead(uint8_t pin) {
   return (high << 8) | low;
 }
 void stopReading(void) {
+  cbi(ADCSRA, ADIE);
   while (bit_is_set(ADCSRA, ADSC))
     ;
   first = true;
@@ -295,13 +469,83 @@ void setupADC(void) {
   // enable a2d conversions
   sbi(ADCSRA, ADEN);
 #endif
-  // Enable adc interrupts
-  // sbi(ADCSRA, ADIE);
+  // ADC interrupts are enabled by tickAnalog, once the pins are known
 }
 
 void setUpValidPins(Configuration_t *config) {
   stopReading();
   validAnalog = 0;
   currentAnalog = 0;
+  adcDiscard = false;
+  setUpMux(config);
   for (int i = 0; i < 6; i++) { setUpAnalogPin(config, i); }
-}
\ No newline at end of file
+}
+// Pin change interrupts fire for any change on any pin in a group, so each
+// attached pin remembers its last level, and only its own edges are passed on
+// to its handler.
+#define MAX_PIN_INTERRUPTS 8
+typedef struct {
+  volatile uint8_t *port;
+  uint8_t mask;
+  uint8_t group;
+  uint8_t mode;
+  bool last;
+  void (*handler)(void);
+} PinInterrupt_t;
+PinInterrupt_t pinInterrupts[MAX_PIN_INTERRUPTS];
+uint8_t pinInterruptCount;
+static inline void dispatchPinChange(uint8_t group) {
+  PinInterrupt_t *interrupt = pinInterrupts;
+  for (uint8_t i = 0; i < pinInterruptCount; i++, interrupt++) {
+    if (interrupt->group != group) continue;
+    bool level = (*interrupt->port & interrupt->mask) != 0;
+    bool changed = level != interrupt->last;
+    interrupt->last = level;
+    if ((interrupt->mode == CHANGE && changed) ||
+        (interrupt->mode == RISING && changed && level) ||
+        (interrupt->mode == FALLING && changed && !level) ||
+        (interrupt->mode == LOW && !level)) {
+      interrupt->handler();
+    }
+  }
+}
+bool attachInterrupt(uint8_t pin, void (*handler)(void), uint8_t mode) {
+  volatile uint8_t *pcicr = digitalPinToPCICR(pin);
+  volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+  if (!pcicr || !pcmsk || pinInterruptCount == MAX_PIN_INTERRUPTS) {
+    return false;
+  }
+  uint8_t port = digitalPinToPort(pin);
+  PinInterrupt_t interrupt = {portInputRegister(port), digitalPinToBitMask(pin),
+                              digitalPinToPCICRbit(pin), mode, false, handler};
+  interrupt.last = (*interrupt.port & interrupt.mask) != 0;
+  uint8_t oldSREG = SREG;
+  cli();
+  pinInterrupts[pinInterruptCount++] = interrupt;
+  *pcmsk |= _BV(digitalPinToPCMSKbit(pin));
+  *pcicr |= _BV(digitalPinToPCICRbit(pin));
+  SREG = oldSREG;
+  return true;
+}
+void detachInterrupt(uint8_t pin) {
+  volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+  if (!pcmsk) return;
+  volatile uint8_t *port = portInputRegister(digitalPinToPort(pin));
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t oldSREG = SREG;
+  cli();
+  *pcmsk &= ~_BV(digitalPinToPCMSKbit(pin));
+  for (uint8_t i = 0; i < pinInterruptCount; i++) {
+    if (pinInterrupts[i].port == port && pinInterrupts[i].mask == mask) {
+      pinInterrupts[i--] = pinInterrupts[--pinInterruptCount];
+    }
+  }
+  SREG = oldSREG;
+}
+ISR(PCINT0_vect) { dispatchPinChange(0); }
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) { dispatchPinChange(1); }
+#endif
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) { dispatchPinChange(2); }
+#endif
@@ -40,7 +40,7 @@ void spi_begin(uint32_t clock, bool cpol, bool cpha, bool lsbfirst) {
   pinMode(PIN_SPI_SCK, OUTPUT);
   digitalWrite(PIN_SPI_SS, 1);
   pinMode(PIN_SPI_SS, OUTPUT);
-  uint8_t config;
+  uint8_t config = 0;
   if (cpol) {
     config |= _BV(CPOL);
   }
@@ -52,6 +52,16 @@ void spi_begin(uint32_t clock, bool cpol, bool cpha, bool lsbfirst) {
   }
   calculateClock(clock, config);
 }
+void spi_setMode(bool cpol, bool cpha) {
+  uint8_t config = SPCR & ~(_BV(CPOL) | _BV(CPHA));
+  if (cpol) {
+    config |= _BV(CPOL);
+  }
+  if (cpha) {
+    config |= _BV(CPHA);
+  }
+  SPCR = config;
+}
 uint8_t spi_transfer(uint8_t data) {
   SPDR = data;
   asm volatile("nop");
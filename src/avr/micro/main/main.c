@@ -56,11 +56,48 @@ void initialise(void) {
   USB_Init();
   sei();
 }
+#ifdef MULTI_ADAPTOR
+Controller_t prevExtraControllers[EXTRA_CONTROLLERS];
+const uint8_t extraEndpoints[EXTRA_CONTROLLERS] = {
+    XINPUT_2_EPADDR_IN, XINPUT_3_EPADDR_IN, XINPUT_4_EPADDR_IN};
+// The other players each have their own endpoint, and only send a report when
+// something changes, the same as the first player
+void sendExtraControllers(void) {
+  for (uint8_t i = 0; i < EXTRA_CONTROLLERS; i++) {
+    if (memcmp(&extraControllers[i], &prevExtraControllers[i],
+               sizeof(XInput_Data_t)) == 0) {
+      continue;
+    }
+    Endpoint_SelectEndpoint(extraEndpoints[i]);
+    if (!Endpoint_IsINReady()) continue;
+    fillReport(&currentReport, &size, &extraControllers[i]);
+    memcpy(&prevExtraControllers[i], &extraControllers[i],
+           sizeof(XInput_Data_t));
+    Endpoint_Write_Stream_LE(&currentReport, size, NULL);
+    Endpoint_ClearIN();
+  }
+  Endpoint_SelectEndpoint(XINPUT_EPADDR_IN);
+}
+#endif
 int main(void) {
   initialise();
   uint8_t cSize = sizeof(XInput_Data_t);
   while (true) {
     USB_USBTask();
+#ifndef MULTI_ADAPTOR
+    // The IN endpoint that reports go to is checked below, so put it back
+    uint8_t prevEndpoint = Endpoint_GetCurrentEndpoint();
+    Endpoint_SelectEndpoint(XINPUT_EPADDR_OUT);
+    if (Endpoint_IsOUTReceived()) {
+      uint8_t buf[8];
+      uint8_t len = Endpoint_BytesInEndpoint();
+      if (len > sizeof(buf)) { len = sizeof(buf); }
+      Endpoint_Read_Stream_LE(buf, len, NULL);
+      Endpoint_ClearOUT();
+      processXInputOutReport(buf, len);
+    }
+    Endpoint_SelectEndpoint(prevEndpoint);
+#endif
     if (isRF) {
       tickRFInput((uint8_t *)&controller, cSize);
     } else {
@@ -103,13 +140,16 @@ int main(void) {
         Endpoint_ClearIN();
       }
     }
+#ifdef MULTI_ADAPTOR
+    if (!isRF) { sendExtraControllers(); }
+#endif
   }
 }
 void EVENT_USB_Device_ConfigurationChanged(void) {
   Endpoint_ConfigureEndpoint(XINPUT_EPADDR_IN, EP_TYPE_INTERRUPT, HID_EPSIZE,
                              1);
-  Endpoint_ConfigureEndpoint(HID_EPADDR_IN, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
 #ifndef MULTI_ADAPTOR
+  Endpoint_ConfigureEndpoint(HID_EPADDR_IN, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
   Endpoint_ConfigureEndpoint(MIDI_EPADDR_IN, EP_TYPE_BULK, HID_EPSIZE, 1);
   Endpoint_ConfigureEndpoint(XINPUT_EPADDR_OUT, EP_TYPE_INTERRUPT, HID_EPSIZE,
                              1);
@@ -73,6 +73,27 @@ void initialise(void) {
   initReports(&config);
   initLEDs(&config);
 }
+#ifdef MULTI_ADAPTOR
+Controller_t prevExtraControllers[EXTRA_CONTROLLERS];
+uint8_t nextPlayer;
+#endif
+// Sends a report for a player if anything has changed. The usb chip picks the
+// endpoint from the report id, so the other players use the ids after
+// REPORT_ID_XINPUT.
+bool sendReport(Controller_t *current, Controller_t *prev, uint8_t player) {
+  if (memcmp(prev, current, sizeof(XInput_Data_t)) == 0) return false;
+  uint8_t size;
+  fillReport(currentReport, &size, current);
+  if (player) { currentReport[0] = REPORT_ID_XINPUT + player; }
+  lastPoll = millis();
+  readyForPacket = false;
+  uint8_t done = FRAME_START_WRITE;
+  writeData(&done, 1);
+  writeData(&size, 1);
+  writeData(currentReport, size);
+  memcpy(prev, current, sizeof(XInput_Data_t));
+  return true;
+}
 int main(void) {
   initialise();
   Serial_InitInterrupt(BAUD, true);
@@ -194,16 +215,23 @@ int main(void) {
         tickInputs(&controller);
         tickLEDs(&controller);
       }
-      uint8_t size;
-      if (memcmp(&prevController, &controller, sizeof(XInput_Data_t)) != 0 && readyForPacket) {
-        fillReport(currentReport, &size, &controller);
-        lastPoll = millis();
-        readyForPacket = false;
-        uint8_t done = FRAME_START_WRITE;
-        writeData(&done, 1);
-        writeData(&size, 1);
-        writeData(currentReport, size);
-        memcpy(&prevController, &controller, sizeof(XInput_Data_t));
+      if (readyForPacket) {
+#ifdef MULTI_ADAPTOR
+        // Only one report can be waiting on the usb chip at a time, so the
+        // players take turns
+        for (uint8_t i = 0; i <= EXTRA_CONTROLLERS; i++) {
+          uint8_t player = nextPlayer;
+          nextPlayer = (nextPlayer + 1) % (EXTRA_CONTROLLERS + 1);
+          if (player == 0 ? sendReport(&controller, &prevController, 0)
+                          : sendReport(&extraControllers[player - 1],
+                                       &prevExtraControllers[player - 1],
+                                       player)) {
+            break;
+          }
+        }
+#else
+        sendReport(&controller, &prevController, 0);
+#endif
       }
     }
   }
@@ -129,6 +129,9 @@ int main(void) {
               data == REPORT_ID_CONTROL) {
             continue;
           }
+          // The other players only use their id to pick an endpoint, and
+          // their reports start the same as the first player's
+          if (data <= REPORT_ID_XINPUT_4) { data = REPORT_ID_XINPUT; }
           Endpoint_Write_8(data);
         } else if (state == 3) {
           packetCount--;
@@ -1,6 +1,7 @@
 #include "eeprom/eeprom.h"
 #include "controller/guitar_includes.h"
 #include "hardware/flash.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "util/util.h"
 #include <string.h>
@@ -48,6 +49,40 @@ Configuration_t loadConfig(void) {
   if (config.main.version < 15) {
     config.debounce.combinedStrum = false;
   }
+  if (config.main.version < 16) {
+    config.debounce.mode = DEBOUNCE_LOCKOUT;
+  }
+  if (config.main.version < 17) {
+    memcpy_P(&config.filter, &default_config.filter,
+             sizeof(default_config.filter));
+  }
+  if (config.main.version < 18) {
+    memcpy_P(&config.curves, &default_config.curves,
+             sizeof(default_config.curves));
+  }
+  if (config.main.version < 19) {
+    config.analogDetectThreshold = ANALOG_DETECT_THRESHOLD;
+  }
+  if (config.main.version < 20) {
+    memcpy_P(&config.shiftRegister, &default_config.shiftRegister,
+             sizeof(default_config.shiftRegister));
+  }
+  if (config.main.version < 21) {
+    memcpy_P(&config.mux, &default_config.mux, sizeof(default_config.mux));
+  }
+  if (config.main.version < 22) {
+    memcpy_P(&config.matrix, &default_config.matrix,
+             sizeof(default_config.matrix));
+  }
+  if (config.main.version < 23) {
+    memcpy_P(&config.encoder, &default_config.encoder,
+             sizeof(default_config.encoder));
+  }
+  if (config.main.version < 24) { config.neck = NO_NECK; }
+  if (config.main.version < 25) {
+    memcpy_P(&config.mpu6050, &default_config.mpu6050,
+             sizeof(default_config.mpu6050));
+  }
   if (config.main.version < CONFIG_VERSION) {
     config.main.version = CONFIG_VERSION;
     writeConfigBlock(0, (uint8_t *)&config, sizeof(Configuration_t));
@@ -59,10 +94,14 @@ void writeConfigBlock(uint16_t offset, const uint8_t *data, uint16_t len) {
   memcpy(newConfig + offset, data, len);
   uint32_t saved_irq;
   if (offset + len >= sizeof(Configuration_t)) {
+    // The other core can't be running from flash while it is being written
+    bool lockout = multicore_lockout_victim_is_initialized(1);
+    if (lockout) { multicore_lockout_start_blocking(); }
     saved_irq = save_and_disable_interrupts();
     flash_range_erase(FLASH_TARGET_OFFSET, FLASH_SECTOR_SIZE);
     flash_range_program(FLASH_TARGET_OFFSET, newConfig, sizeof(newConfig));
     restore_interrupts(saved_irq);
+    if (lockout) { multicore_lockout_end_blocking(); }
   }
 }
 void readConfigBlock(uint16_t offset, uint8_t *data, uint16_t len) {
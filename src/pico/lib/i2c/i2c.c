@@ -29,6 +29,8 @@
 // === MODIFIED ===
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "pico/time.h"
 #include "i2c/i2c.h"
 #include "pins/pins.h"
 #include "pins_arduino.h"
@@ -40,7 +42,105 @@
 #endif
 
 // === MODIFIED ===
-static uint16_t TIMEOUT = 1000;
+// How long the blocking functions wait for a queued transfer, in microseconds
+static uint16_t TIMEOUT = 5000;
+
+// Queued transactions push their commands straight into the hardware FIFOs,
+// and the I2C interrupt moves on to the next step once a stop is seen. The
+// SDK's blocking functions wait for the same stop, so the interrupts are only
+// unmasked while the queue is busy, and the blocking functions wait for the
+// queue to empty first.
+static TwiTransaction_t *twi_async;
+static bool twi_asyncReading;
+static alarm_id_t twi_asyncAlarm;
+static void twi_sendAsync(bool read) {
+  i2c_hw_t *hw = i2c_get_hw(i2c1);
+  twi_asyncReading = read;
+  hw->enable = 0;
+  hw->tar = twi_async->address;
+  hw->enable = 1;
+  (void)hw->clr_stop_det;
+  (void)hw->clr_tx_abrt;
+  if (read) {
+    for (uint8_t i = 0; i < twi_async->length; i++) {
+      bool last = i == twi_async->length - 1;
+      hw->data_cmd =
+          I2C_IC_DATA_CMD_CMD_BITS | (last ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+    }
+  } else {
+    hw->data_cmd = twi_async->pointer | I2C_IC_DATA_CMD_STOP_BITS;
+  }
+}
+static int64_t twi_asyncWaited(alarm_id_t id, void *user_data) {
+  twi_asyncAlarm = 0;
+  twi_sendAsync(true);
+  return 0;
+}
+static void twi_asyncDone(bool success) {
+  // Mask the interrupts before anything else can start a blocking transfer
+  i2c_get_hw(i2c1)->intr_mask = 0;
+  twi_finishTransaction(success);
+}
+static void twi_asyncIRQ(void) {
+  i2c_hw_t *hw = i2c_get_hw(i2c1);
+  uint32_t status = hw->intr_stat;
+  if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+    twi_asyncDone(false);
+    return;
+  }
+  if (!(status & I2C_IC_INTR_STAT_R_STOP_DET_BITS)) return;
+  (void)hw->clr_stop_det;
+  if (!twi_asyncReading) {
+    if (twi_async->delayMicros) {
+      twi_asyncAlarm = alarm_pool_add_alarm_in_us(
+          inputAlarmPool, twi_async->delayMicros, twi_asyncWaited, NULL, true);
+    } else {
+      twi_sendAsync(true);
+    }
+    return;
+  }
+  bool success = hw->rxflr >= twi_async->length;
+  for (uint8_t i = 0; i < twi_async->length && hw->rxflr; i++) {
+    twi_async->data[i] = hw->data_cmd;
+  }
+  twi_asyncDone(success);
+}
+void twi_startTransaction(TwiTransaction_t *transaction) {
+  twi_async = transaction;
+  twi_sendAsync(false);
+  i2c_get_hw(i2c1)->intr_mask =
+      I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+}
+
+// Gives up on a queued transfer that never finished, so that a stuck bus can't
+// hold up the blocking functions forever
+static void twi_abortAsync(void) {
+  i2c_hw_t *hw = i2c_get_hw(i2c1);
+  hw->intr_mask = 0;
+  if (twi_asyncAlarm) {
+    alarm_pool_cancel_alarm(inputAlarmPool, twi_asyncAlarm);
+    twi_asyncAlarm = 0;
+  }
+  hw->enable |= I2C_IC_ENABLE_ABORT_BITS;
+  uint32_t start = time_us_32();
+  while ((hw->enable & I2C_IC_ENABLE_ABORT_BITS) &&
+         time_us_32() - start < TIMEOUT) {}
+  (void)hw->clr_tx_abrt;
+  (void)hw->clr_stop_det;
+  twi_finishTransaction(false);
+}
+static bool twi_waitForQueue(void) {
+  uint32_t start = time_us_32();
+  while (twi_queueBusy()) {
+    if (time_us_32() - start > TIMEOUT) {
+      twi_abortAsync();
+      return false;
+    }
+  }
+  return true;
+}
 
 /*
  * Function twi_init
@@ -55,6 +155,18 @@ void twi_init(void) {
   gpio_set_function(PIN_WIRE_SCL, GPIO_FUNC_I2C);
   gpio_pull_up(PIN_WIRE_SDA);
   gpio_pull_up(PIN_WIRE_SCL);
+  i2c_get_hw(i2c1)->intr_mask = 0;
+  // The SDK doesn't allow an exclusive handler to be set twice
+  static bool irqSet = false;
+  if (!irqSet) {
+    irq_set_exclusive_handler(I2C1_IRQ, twi_asyncIRQ);
+    irq_set_enabled(I2C1_IRQ, true);
+    irqSet = true;
+  }
+}
+
+void twi_setFrequency(uint32_t frequency) {
+  i2c_set_baudrate(i2c1, frequency);
 }
 
 /*
@@ -78,6 +190,7 @@ void twi_disable(void) { i2c_deinit(i2c0); }
 // === MODIFIED ===
 bool twi_readFrom(uint8_t address, uint8_t *data, uint8_t length,
                   uint8_t sendStop) {
+  if (!twi_waitForQueue()) return false;
   int ret = i2c_read_blocking(i2c1, address, data, length, !sendStop);
   return ret > 0;
 }
@@ -96,6 +209,7 @@ bool twi_readFrom(uint8_t address, uint8_t *data, uint8_t length,
  */
 bool twi_writeTo(uint8_t address, uint8_t *data, uint8_t length, uint8_t wait,
                  uint8_t sendStop) {
+  if (!twi_waitForQueue()) return false;
   uint8_t ret = i2c_write_blocking(i2c1, address, data, length, !sendStop);
   // i2c_write_blocking finishes when the write is sent but not when it is complete. Delaying 60us is enough to actually wait for the write.
   _delay_us(60);
@@ -1,8 +1,14 @@
 #include "pins/pins.h"
 #include "eeprom/eeprom.h"
 #include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pico/time.h"
+#include "port_sampler.pio.h"
 #include "stddef.h"
+#include "timer/timer.h"
 #include "util/util.h"
 
 void digitalWrite(uint8_t pin, uint8_t val) { gpio_put(pin, val); }
@@ -26,6 +32,141 @@ bool digitalReadPin(Pin_t pin) {
   AnalogInfo_t info = joyData[pin.analogOffset];
   return info.value > info.threshold;
 }
+typedef struct {
+  uint32_t mask;
+  uint16_t button;
+} ScannedPin_t;
+// Pins that are pressed when low are flipped, so that a set bit is a press
+uint32_t scannedInvert;
+ScannedPin_t scannedPins[XBOX_BTN_COUNT];
+uint8_t scannedPinCount;
+void setUpPortScan(Pin_t *pins, uint8_t count) {
+  scannedInvert = 0;
+  scannedPinCount = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t mask = 1u << pins[i].pin;
+    if (!pins[i].eq) { scannedInvert |= mask; }
+    scannedPins[scannedPinCount++] =
+        (ScannedPin_t){mask, 1u << pins[i].offset};
+  }
+}
+uint16_t mapPortSnapshot(uint32_t snapshot) {
+  snapshot ^= scannedInvert;
+  uint16_t ret = 0;
+  ScannedPin_t *pin = scannedPins;
+  for (uint8_t i = 0; i < scannedPinCount; i++, pin++) {
+    if (snapshot & pin->mask) { ret |= pin->button; }
+  }
+  return ret;
+}
+uint16_t readPortScan(void) { return mapPortSnapshot(gpio_get_all()); }
+// The sampler has its own DMA ring, which works the same way as the ADC ring
+// below. It holds 32ms of samples.
+#define PORT_SAMPLE_RING 256
+uint32_t portSamples[PORT_SAMPLE_RING];
+uint32_t *portSamplesStart = portSamples;
+int portSampleChannel;
+// The state machine and DMA channels are claimed once, and then the sampler
+// keeps running
+int portSamplerSm = -1;
+// The number of samples that have been read so far. micros() wraps every 71
+// minutes, so the sample count and start time are kept in 64 bits.
+uint64_t portSamplesRead;
+uint64_t portSamplerStartMicros;
+bool startPortSampler(void) {
+  if (portSamplerSm >= 0) return true;
+  PIO pio = pio1;
+  int sm = pio_claim_unused_sm(pio, false);
+  if (sm < 0) return false;
+  // If anything else is missing, give back what was claimed, and the pins are
+  // read each tick instead
+  int data = dma_claim_unused_channel(false);
+  int control = data < 0 ? -1 : dma_claim_unused_channel(false);
+  if (control < 0 || !pio_can_add_program(pio, &port_sampler_program)) {
+    if (data >= 0) { dma_channel_unclaim(data); }
+    if (control >= 0) { dma_channel_unclaim(control); }
+    pio_sm_unclaim(pio, sm);
+    return false;
+  }
+  portSamplerSm = sm;
+  portSampleChannel = data;
+  uint offset = pio_add_program(pio, &port_sampler_program);
+  float clkdiv = clock_get_hz(clk_sys) / (32.0f * 1000000 / PORT_SAMPLE_US);
+  port_sampler_program_init(pio, sm, offset, clkdiv);
+
+  dma_channel_config c = dma_channel_get_default_config(portSampleChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+  channel_config_set_chain_to(&c, control);
+  dma_channel_configure(portSampleChannel, &c, portSamplesStart,
+                        &pio->rxf[sm], PORT_SAMPLE_RING, false);
+
+  c = dma_channel_get_default_config(control);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(control, &c,
+                        &dma_hw->ch[portSampleChannel].al2_write_addr_trig,
+                        &portSamplesStart, 1, false);
+  dma_channel_start(portSampleChannel);
+  portSamplesRead = 0;
+  portSamplerStartMicros = time_us_64();
+  pio_sm_set_enabled(pio, sm, true);
+  return true;
+}
+bool readPortSample(uint16_t *buttons, unsigned long *ms,
+                    unsigned long *us) {
+  // The ring only says where the DMA is within the ring, so use the time to
+  // work out which pass over the ring it is on.
+  uint32_t position =
+      PORT_SAMPLE_RING - dma_hw->ch[portSampleChannel].transfer_count;
+  uint64_t expected =
+      (time_us_64() - portSamplerStartMicros) / PORT_SAMPLE_US;
+  int32_t diff = (position - (uint32_t)expected) & (PORT_SAMPLE_RING - 1);
+  if (diff >= PORT_SAMPLE_RING / 2) { diff -= PORT_SAMPLE_RING; }
+  uint64_t written = expected + diff;
+  if ((int64_t)(written - portSamplesRead) <= 0) { return false; }
+  // If we fell too far behind, the oldest samples have been overwritten
+  if (written - portSamplesRead > PORT_SAMPLE_RING / 2) {
+    portSamplesRead = written - PORT_SAMPLE_RING / 2;
+  }
+  uint64_t index = portSamplesRead++;
+  *buttons = mapPortSnapshot(portSamples[index & (PORT_SAMPLE_RING - 1)]);
+  // These wrap the same way as micros() and millis()
+  uint64_t sampled = portSamplerStartMicros + index * PORT_SAMPLE_US;
+  *us = sampled;
+  *ms = us_to_ms(sampled);
+  return true;
+}
+uint32_t detectMask;
+uint32_t detectSnapshot;
+void startPinDetection(bool (*skip)(uint8_t pin)) {
+  detectMask = 0;
+  for (uint8_t i = 0; i < NUM_DIGITAL_PINS; i++) {
+    if (!skip(i)) { detectMask |= 1u << i; }
+  }
+  gpio_init_mask(detectMask);
+  gpio_set_dir_in_masked(detectMask);
+  for (uint8_t i = 0; i < NUM_DIGITAL_PINS; i++) {
+    if (detectMask & (1u << i)) { gpio_pull_up(i); }
+  }
+  // Every pin waits for its pullup at the same time
+  _delay_us(100);
+  detectSnapshot = gpio_get_all() & detectMask;
+}
+uint8_t findChangedPin(void) {
+  uint32_t changed = (gpio_get_all() ^ detectSnapshot) & detectMask;
+  if (!changed) return INVALID_PIN;
+  return __builtin_ctz(changed);
+}
+void stopPinDetection(void) {
+  for (uint8_t i = 0; i < NUM_DIGITAL_PINS; i++) {
+    if (detectMask & (1u << i)) { gpio_disable_pulls(i); }
+  }
+  detectMask = 0;
+}
 void digitalWritePin(Pin_t pin, bool value) {
   // If SIO is disabled for a pin (aka its using a different function like i2c
   // or spi), then digitalWrite needs to override it.
@@ -42,6 +183,31 @@ void digitalWritePin(Pin_t pin, bool value) {
   }
   gpio_put(pin.pin, value);
 }
+// The round robin can't change the select pins of a multiplexer, so a timer
+// steps through the multiplexer inputs instead. Each step waits for the
+// multiplexer to settle and then for two sweeps, so that the most recent
+// sweep was taken entirely after it settled.
+MuxConfig_t mux;
+uint8_t muxEntries[MUX_CHANNELS];
+uint8_t muxCount;
+uint8_t muxCurrent;
+volatile uint16_t muxSamples[MAX_ANALOG_INPUTS];
+repeating_timer_t muxTimer;
+bool muxRunning = false;
+void setUpMux(Configuration_t *config) {
+  mux = config->mux;
+  if (mux.pin == INVALID_PIN) { return; }
+  for (uint8_t i = 0; i < sizeof(mux.select); i++) {
+    if (mux.select[i] != INVALID_PIN) { pinMode(mux.select[i], OUTPUT); }
+  }
+}
+void selectMuxChannel(uint8_t channel) {
+  for (uint8_t i = 0; i < sizeof(mux.select); i++) {
+    if (mux.select[i] != INVALID_PIN) {
+      gpio_put(mux.select[i], bit_check(channel, i));
+    }
+  }
+}
 void setUpAnalogPin(Configuration_t *config, uint8_t offset) {
   AnalogInfo_t ret = {0};
   ret.offset = offset;
@@ -52,6 +218,12 @@ void setUpAnalogPin(Configuration_t *config, uint8_t offset) {
       config->main.tiltType != ANALOGUE) {
     return;
   }
+  ret.muxChannel = INVALID_PIN;
+  if (isMuxPin(pin)) {
+    if (mux.pin == INVALID_PIN) { return; }
+    ret.muxChannel = pin - MUX_PIN_BASE;
+    pin = mux.pin;
+  }
   ret.pin = pin;
   ret.hasDigital = false;
   ret.inverted = apin.inverted;
@@ -60,26 +232,150 @@ void setUpAnalogPin(Configuration_t *config, uint8_t offset) {
 }
 void setUpAnalogDigitalPin(Pin_t *button, uint8_t pin, uint16_t threshold) {
   AnalogInfo_t ret = {0};
-  ret.offset = pin;
+  ret.offset = button->offset;
   ret.hasDigital = true;
   ret.threshold = threshold;
+  ret.muxChannel = INVALID_PIN;
+  if (isMuxPin(pin)) {
+    if (mux.pin == INVALID_PIN) { return; }
+    ret.muxChannel = pin - MUX_PIN_BASE;
+    pin = mux.pin;
+  }
   ret.pin = pin;
   pinMode(pin, INPUT);
   button->analogOffset = validAnalog;
   joyData[validAnalog++] = ret;
 }
+// The ADC runs in round robin mode over every configured channel, and DMA
+// copies the results out of the FIFO into adcRing. Once a pass over the ring
+// finishes, the control channel points the data channel back at the start of
+// the ring, so this runs forever without any help from the cpu.
+#define ADC_SWEEPS 4
+// 48MHz / 480 gives 100k samples a second, shared between all channels
+#define ADC_CLOCK_DIV 480
+// Each sweep only takes up adcChannels entries, so the ring is packed tighter
+// than this array suggests.
+uint16_t adcRing[ADC_SWEEPS][NUM_ANALOG_INPUTS];
+uint16_t *adcRingStart = adcRing[0];
+// The position of each joyData entry within a sweep
+uint8_t adcSlot[MAX_ANALOG_INPUTS];
+uint8_t adcChannels;
+int adcDataChannel = -1;
+int adcControlChannel;
+bool adcRunning = false;
+// Work out which sweep was finished most recently. The DMA is at least two
+// sweeps away from overwriting it, so it can be read without locking.
+uint16_t *latestSweep(void) {
+  uint32_t remaining = dma_hw->ch[adcDataChannel].transfer_count;
+  uint32_t written = ADC_SWEEPS * adcChannels - remaining;
+  uint8_t sweep = (written / adcChannels + ADC_SWEEPS - 1) % ADC_SWEEPS;
+  return adcRingStart + sweep * adcChannels;
+}
+bool stepMux(repeating_timer_t *rt) {
+  uint8_t entry = muxEntries[muxCurrent];
+  muxSamples[entry] = latestSweep()[adcSlot[entry]];
+  if (++muxCurrent == muxCount) { muxCurrent = 0; }
+  selectMuxChannel(joyData[muxEntries[muxCurrent]].muxChannel);
+  return true;
+}
+void startMuxScan(void) {
+  muxCount = 0;
+  for (int i = 0; i < validAnalog; i++) {
+    if (joyData[i].muxChannel != INVALID_PIN) { muxEntries[muxCount++] = i; }
+  }
+  if (!muxCount) return;
+  muxCurrent = 0;
+  selectMuxChannel(joyData[muxEntries[0]].muxChannel);
+  // Each sample takes ADC_CLOCK_DIV + 1 cycles of the ADC clock
+  uint32_t sweepMicros = adcChannels * (ADC_CLOCK_DIV + 1) /
+                             (clock_get_hz(clk_adc) / 1000000) +
+                         1;
+  alarm_pool_add_repeating_timer_us(inputAlarmPool,
+                                    -(mux.settleMicros + sweepMicros * 2),
+                                    stepMux, NULL, &muxTimer);
+  muxRunning = true;
+}
+void startADCRing(void) {
+  uint8_t mask = 0;
+  for (int i = 0; i < validAnalog; i++) {
+    mask |= _BV(joyData[i].pin - PIN_A0);
+  }
+  // Round robin goes through the channels in order, so the position of a
+  // channel in a sweep is the number of enabled channels below it.
+  adcChannels = 0;
+  uint8_t first = 0;
+  for (int ch = NUM_ANALOG_INPUTS - 1; ch >= 0; ch--) {
+    if (bit_check(mask, ch)) {
+      adcChannels++;
+      first = ch;
+    }
+  }
+  for (int i = 0; i < validAnalog; i++) {
+    uint8_t ch = joyData[i].pin - PIN_A0;
+    adcSlot[i] = __builtin_popcount(mask & (_BV(ch) - 1));
+  }
+  if (adcDataChannel == -1) {
+    adcDataChannel = dma_claim_unused_channel(true);
+    adcControlChannel = dma_claim_unused_channel(true);
+  }
+  adc_fifo_setup(true, true, 1, false, false);
+  adc_set_clkdiv(ADC_CLOCK_DIV);
+  adc_select_input(first);
+  adc_set_round_robin(mask);
+
+  dma_channel_config c = dma_channel_get_default_config(adcDataChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, DREQ_ADC);
+  channel_config_set_chain_to(&c, adcControlChannel);
+  dma_channel_configure(adcDataChannel, &c, adcRingStart, &adc_hw->fifo,
+                        ADC_SWEEPS * adcChannels, false);
+
+  c = dma_channel_get_default_config(adcControlChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(adcControlChannel, &c,
+                        &dma_hw->ch[adcDataChannel].al2_write_addr_trig,
+                        &adcRingStart, 1, false);
+  dma_channel_start(adcDataChannel);
+  adc_run(true);
+  adcRunning = true;
+  startMuxScan();
+}
 void tickAnalog(void) {
   if (validAnalog == 0) return;
+  if (!adcRunning) {
+    startADCRing();
+    return;
+  }
+  uint16_t *samples = latestSweep();
   for (int i = 0; i < validAnalog; i++) {
     AnalogInfo_t *info = &joyData[i];
-    int16_t data = analogRead(info->pin - PIN_A0);
-    if (!joyData[i].hasDigital) {
-      data = (data - 512);
+    int16_t data = info->muxChannel == INVALID_PIN ? samples[adcSlot[i]]
+                                                   : muxSamples[i];
+    if (!info->hasDigital) {
+      data = (data - 2048);
       if (info->inverted) data = -data;
     }
-    data = data * 64;
-    info->value = data;
+    // Samples are 12 bits, scale them up to fill the same range as the AVR
+    info->value = data * 16;
+  }
+}
+void stopReading(void) {
+  if (!adcRunning) return;
+  if (muxRunning) {
+    cancel_repeating_timer(&muxTimer);
+    muxRunning = false;
   }
+  adc_run(false);
+  dma_channel_abort(adcDataChannel);
+  dma_channel_abort(adcControlChannel);
+  adc_set_round_robin(0);
+  adc_fifo_setup(false, false, 0, false, false);
+  adc_fifo_drain();
+  adcRunning = false;
 }
 
 uint16_t analogRead(uint8_t pin) {
@@ -101,5 +397,35 @@ void pinMode(uint8_t pin, uint8_t mode) {
 void setupADC(void) { adc_init(); }
 
 void setUpValidPins(Configuration_t *config) {
+  stopReading();
+  setUpMux(config);
   for (int i = 0; i < 6; i++) { setUpAnalogPin(config, i); }
-}
\ No newline at end of file
+}
+// The SDK only has one GPIO callback for every pin, so it is shared through a
+// table of handlers.
+void (*pinInterrupts[NUM_BANK0_GPIOS])(void);
+void dispatchPinInterrupt(uint gpio, uint32_t events) {
+  if (pinInterrupts[gpio]) { pinInterrupts[gpio](); }
+}
+bool attachInterrupt(uint8_t pin, void (*handler)(void), uint8_t mode) {
+  if (pin >= NUM_BANK0_GPIOS) return false;
+  uint32_t events = GPIO_IRQ_LEVEL_LOW;
+  if (mode == CHANGE) {
+    events = GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL;
+  } else if (mode == RISING) {
+    events = GPIO_IRQ_EDGE_RISE;
+  } else if (mode == FALLING) {
+    events = GPIO_IRQ_EDGE_FALL;
+  }
+  pinInterrupts[pin] = handler;
+  gpio_set_irq_enabled_with_callback(pin, events, true, dispatchPinInterrupt);
+  return true;
+}
+void detachInterrupt(uint8_t pin) {
+  if (pin >= NUM_BANK0_GPIOS) return;
+  gpio_set_irq_enabled(pin,
+                       GPIO_IRQ_LEVEL_LOW | GPIO_IRQ_EDGE_RISE |
+                           GPIO_IRQ_EDGE_FALL,
+                       false);
+  pinInterrupts[pin] = NULL;
+}
@@ -0,0 +1,126 @@
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "pins_arduino.h"
+#include "psx.pio.h"
+#include "spi/spi.h"
+#include "timer/timer.h"
+#include <string.h>
+// Eight bits at 4us each, and the loop around them
+#define PSX_BYTE_US 35
+#define PSX_ATTENTION_US 20
+PIO psxPio = pio1;
+int psxSm = -1;
+uint psxOffset;
+int psxTxChannel;
+int psxRxChannel;
+uint8_t psxAckTimeout;
+// The length, and then the bytes to send
+uint8_t psxFrame[PSX_MAX_FRAME + 1];
+unsigned long psxStartMicros;
+unsigned long psxFrameMicros;
+bool psxRunning;
+bool psxComplete;
+bool psx_init(void) {
+  if (psxSm >= 0) return true;
+  int sm = pio_claim_unused_sm(psxPio, false);
+  if (sm < 0) return false;
+  // Give back anything that was claimed if the rest isn't there, so that a
+  // later call can try again
+  int tx = dma_claim_unused_channel(false);
+  int rx = tx < 0 ? -1 : dma_claim_unused_channel(false);
+  if (rx < 0 || !pio_can_add_program(psxPio, &psx_program)) {
+    if (tx >= 0) { dma_channel_unclaim(tx); }
+    if (rx >= 0) { dma_channel_unclaim(rx); }
+    pio_sm_unclaim(psxPio, sm);
+    return false;
+  }
+  psxSm = sm;
+  psxTxChannel = tx;
+  psxRxChannel = rx;
+  psxOffset = pio_add_program(psxPio, &psx_program);
+  psx_program_init(psxPio, psxSm, psxOffset, PIN_SPI_MOSI, PIN_SPI_MISO,
+                   PIN_SPI_SCK, PIN_PS2_ATT, PIN_PS2_ACK);
+  dma_channel_config c = dma_channel_get_default_config(psxTxChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(psxPio, psxSm, true));
+  dma_channel_configure(psxTxChannel, &c, &psxPio->txf[psxSm], psxFrame, 0,
+                        false);
+  c = dma_channel_get_default_config(psxRxChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, pio_get_dreq(psxPio, psxSm, false));
+  // Bytes are shifted in from the top, so they end up in the last byte
+  dma_channel_configure(psxRxChannel, &c, NULL,
+                        (io_ro_8 *)&psxPio->rxf[psxSm] + 3, 0, false);
+  psx_setAckTimeout(15);
+  psxRunning = false;
+  pio_sm_set_enabled(psxPio, psxSm, true);
+  return true;
+}
+void psx_setAckTimeout(uint8_t timeout) {
+  // Without psx_init, the program isn't there to patch
+  if (psxRunning || psxSm < 0) return;
+  // Each count waiting for ACK is 16us
+  uint8_t loops = (timeout + 15) / 16;
+  if (!loops) loops = 1;
+  if (loops > 32) loops = 32;
+  psxAckTimeout = loops * 16;
+  psxPio->instr_mem[psxOffset + psx_offset_timeout] =
+      pio_encode_set(pio_y, loops - 1);
+}
+bool psx_start(const uint8_t *out, uint8_t outLength, uint8_t *in,
+               uint8_t length) {
+  if (psxSm < 0 || psxRunning || !length || length > PSX_MAX_FRAME ||
+      outLength > length) {
+    return false;
+  }
+  psxFrame[0] = length - 1;
+  memcpy(psxFrame + 1, out, outLength);
+  memset(psxFrame + 1 + outLength, 0, length - outLength);
+  psxRunning = true;
+  psxComplete = false;
+  psxStartMicros = micros();
+  psxFrameMicros =
+      PSX_ATTENTION_US + length * (PSX_BYTE_US + (uint32_t)psxAckTimeout);
+  dma_channel_set_write_addr(psxRxChannel, in, false);
+  dma_channel_set_trans_count(psxRxChannel, length, true);
+  dma_channel_set_read_addr(psxTxChannel, psxFrame, false);
+  dma_channel_set_trans_count(psxTxChannel, length + 1, true);
+  return true;
+}
+// Puts everything back to how it is between frames, after a controller stops
+// responding part way through one
+void psxAbort(void) {
+  dma_channel_abort(psxTxChannel);
+  dma_channel_abort(psxRxChannel);
+  pio_sm_set_enabled(psxPio, psxSm, false);
+  pio_sm_clear_fifos(psxPio, psxSm);
+  pio_sm_restart(psxPio, psxSm);
+  pio_sm_exec(psxPio, psxSm, pio_encode_jmp(psxOffset));
+  uint32_t outputs =
+      (1u << PIN_SPI_MOSI) | (1u << PIN_SPI_SCK) | (1u << PIN_PS2_ATT);
+  pio_sm_set_pins_with_mask(psxPio, psxSm, outputs, outputs);
+  pio_sm_set_enabled(psxPio, psxSm, true);
+}
+bool psx_busy(void) {
+  if (!psxRunning) return false;
+  if (!dma_channel_is_busy(psxRxChannel)) {
+    psxComplete = true;
+  } else if (micros() - psxStartMicros < psxFrameMicros) {
+    return true;
+  } else {
+    psxAbort();
+  }
+  psxRunning = false;
+  return false;
+}
+bool psx_ok(void) { return psxComplete; }
+bool psx_ackSeen(void) {
+  if (psxSm < 0) return false;
+  bool seen = pio_interrupt_get(psxPio, psxSm);
+  pio_interrupt_clear(psxPio, psxSm);
+  return seen;
+}
@@ -14,4 +14,12 @@ unsigned long micros(void) {
 }
 
 void setupMicrosTimer(void) {
+}
+
+// The default pool uses hardware alarm 3
+#define INPUT_ALARM_NUM 2
+alarm_pool_t *inputAlarmPool;
+void setupInputAlarmPool(void) {
+  // The mux timer and the i2c delay alarm
+  inputAlarmPool = alarm_pool_create(INPUT_ALARM_NUM, 4);
 }
\ No newline at end of file
@@ -34,6 +34,7 @@
 //--------------------------------------------------------------------+
 #  include "common/tusb_common.h"
 #  include "device/usbd_pvt.h"
+#  include "output/reports.h"
 #  include "xinput_device.h"
 
 //--------------------------------------------------------------------+
@@ -157,8 +158,6 @@ uint16_t xinputd_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc,
 
 bool xinputd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result,
                      uint32_t xferred_bytes) {
-  (void)result;
-
   uint8_t itf = 0;
   xinputd_interface_t *p_xinput = _xinputd_itf;
 
@@ -169,6 +168,9 @@ bool xinputd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result,
   }
 
   if (ep_addr == p_xinput->ep_out) {
+    if (result == XFER_RESULT_SUCCESS) {
+      processXInputOutReport(p_xinput->epout_buf, xferred_bytes);
+    }
     TU_ASSERT(usbd_edpt_xfer(rhport, p_xinput->ep_out, p_xinput->epout_buf,
                              sizeof(p_xinput->epout_buf)));
   }
@@ -13,7 +13,9 @@
 #include "output/descriptors.h"
 #include "output/reports.h"
 #include "output/serial_handler.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
+#include "pico/util/queue.h"
 #include "pins/pins.h"
 #include "pins_arduino.h"
 #include "rf/rf.h"
@@ -38,6 +40,9 @@ uint8_t inputType;
 uint8_t pollRate;
 
 CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN uint8_t buf[64];
+// Commands for core 1. The SIO FIFO can't be used for these, as the flash
+// lockout handler on core 1 throws away anything it finds there.
+queue_t inputCommands;
 bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage,
                                 tusb_control_request_t const *request) {
   if (request->bRequest == HID_REQ_GetReport &&
@@ -90,7 +95,15 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage,
       tud_control_xfer(rhport, request, buf, request->wLength);
     } else if (stage == CONTROL_STAGE_ACK) {
       int cmd = request->wValue;
-      processHIDWriteFeatureReport(cmd, request->wLength, buf);
+      if (!isRF &&
+          (cmd == COMMAND_FIND_DIGITAL || cmd == COMMAND_FIND_ANALOG)) {
+        // Pin detection reconfigures the inputs, so it has to happen on the
+        // core that is reading them
+        uint8_t command = cmd;
+        queue_try_add(&inputCommands, &command);
+      } else {
+        processHIDWriteFeatureReport(cmd, request->wLength, buf);
+      }
       if (isRF) {
         uint8_t buf2[32];
         uint8_t buf3[32];
@@ -172,17 +185,105 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
   return NULL;
 }
 Controller_t controller;
+// Inputs are read on core 1 at a fixed rate, and then published with a
+// sequence lock. The sequence is odd while the controller is being written,
+// so core 0 can tell if it read a half written controller and try again,
+// without either core ever having to wait for the other.
+#define INPUT_TICK_US 250
+Controller_t inputController;
+Controller_t publishedController;
+#ifdef MULTI_ADAPTOR
+// The other players on a multitap are published along with the first
+Controller_t publishedExtraControllers[EXTRA_CONTROLLERS];
+Controller_t sentExtraControllers[EXTRA_CONTROLLERS];
+Controller_t prevExtraControllers[EXTRA_CONTROLLERS];
+#endif
+volatile uint32_t publishedSequence;
+void publishController(void) {
+  publishedSequence++;
+  __dmb();
+  memcpy(&publishedController, &inputController, sizeof(Controller_t));
+#ifdef MULTI_ADAPTOR
+  memcpy(publishedExtraControllers, extraControllers,
+         sizeof(publishedExtraControllers));
+#endif
+  __dmb();
+  publishedSequence++;
+}
+void readPublishedController(void) {
+  uint32_t sequence;
+  do {
+    sequence = publishedSequence;
+    __dmb();
+    memcpy(&controller, &publishedController, sizeof(Controller_t));
+#ifdef MULTI_ADAPTOR
+    memcpy(sentExtraControllers, publishedExtraControllers,
+           sizeof(sentExtraControllers));
+#endif
+    __dmb();
+  } while ((sequence & 1) || sequence != publishedSequence);
+}
+Configuration_t inputConfig;
+void core1_entry(void) {
+  // Allow core 0 to pause this core while it writes to flash
+  multicore_lockout_victim_init();
+  // Interrupts go to the core that set them up, so the inputs are set up here
+  // to keep their interrupts on the same core as the ticks. Alarms go through
+  // their pool's IRQ instead, so the inputs get a pool owned by this core.
+  setupInputAlarmPool();
+  initInputs(&inputConfig);
+  initLEDs(&inputConfig);
+  uint32_t next = time_us_32();
+  uint8_t command;
+  while (1) {
+    while (queue_try_remove(&inputCommands, &command)) {
+      handleCommand(command);
+    }
+    tickInputs(&inputController);
+    tickLEDs(&inputController);
+    publishController();
+    next += INPUT_TICK_US;
+    // If a tick ran long (slow i2c or ps2 reads), start again from now instead
+    // of running a burst of ticks to catch up.
+    if ((int32_t)(time_us_32() - next) > 0) {
+      next = time_us_32();
+    } else {
+      while ((int32_t)(time_us_32() - next) < 0) {}
+    }
+  }
+}
 USB_Report_Data_t previousReport;
 USB_Report_Data_t currentReport;
 uint8_t size;
+#ifdef MULTI_ADAPTOR
+// The other players each have their own XInput interface after the first, and
+// only send a report when something changes, the same as the first player
+void sendExtraControllers(void) {
+  USB_Report_Data_t report;
+  uint8_t reportSize;
+  for (uint8_t i = 0; i < EXTRA_CONTROLLERS; i++) {
+    if (memcmp(&sentExtraControllers[i], &prevExtraControllers[i],
+               sizeof(XInput_Data_t)) == 0) {
+      continue;
+    }
+    if (!tud_xinput_n_ready(i + 1)) continue;
+    fillReport(&report, &reportSize, &sentExtraControllers[i]);
+    memcpy(&prevExtraControllers[i], &sentExtraControllers[i],
+           sizeof(XInput_Data_t));
+    tud_xinput_n_report(i + 1, 0, &report, reportSize);
+  }
+}
+#endif
 void hid_task(void) {
   static uint32_t start_ms = 0;
   if (isRF) {
     tickRFInput((uint8_t *)&controller, sizeof(XInput_Data_t));
   } else {
-    tickInputs(&controller);
-    tickLEDs(&controller);
     if (millis() - start_ms < pollRate) return;
+    readPublishedController();
+#ifdef MULTI_ADAPTOR
+    sendExtraControllers();
+#endif
   }
   fillReport(&currentReport, &size, &controller);
   if (memcmp(&currentReport, &previousReport, size) != 0) {
@@ -240,14 +341,16 @@ void initialise(void) {
     deviceType = REAL_DRUM_SUBTYPE;
   }
   setupMicrosTimer();
+  initReports(&config);
   if (config.rf.rfInEnabled) {
     initRF(false, config.rf.id, generate_crc32());
     isRF = true;
+    initLEDs(&config);
   } else {
-    initInputs(&config);
+    inputConfig = config;
+    queue_init(&inputCommands, sizeof(uint8_t), 4);
+    multicore_launch_core1(core1_entry);
   }
-  initReports(&config);
-  initLEDs(&config);
 }
 int main() {
   initialise();
@@ -260,7 +363,6 @@ void writeToUSB(const void *const Buffer, uint8_t Length, uint8_t report,
                 const void *request) {
   tud_control_xfer(report, request, (uint8_t *)Buffer + 1, Length - 1);
 }
-void stopReading(void) {}
 
 usbd_class_driver_t driver[] = {{.init = xinputd_init,
                                  .reset = xinputd_reset,
@@ -84,7 +84,12 @@ extern "C" {
 #define CFG_TUD_MSC 0
 #define CFG_TUD_MIDI 1
 #define CFG_TUD_VENDOR 0
-#define CFG_TUD_XINPUT 2
+// The multi adaptor has an XInput interface for each player
+#ifdef MULTI_ADAPTOR
+#  define CFG_TUD_XINPUT 4
+#else
+#  define CFG_TUD_XINPUT 2
+#endif
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
 #define CFG_TUD_HID_EP_BUFSIZE HID_EPSIZE
@@ -35,7 +35,6 @@ uint8_t inputType;
 bool typeIsGuitar;
 bool typeIsDrum;
 bool isRF = false;
-void stopReading(void) {}
 
 void initialise(void) {
   board_init();
@@ -120,8 +120,76 @@ typedef struct {
   uint8_t buttons;
   uint8_t strum;
   bool combinedStrum;
+  uint8_t mode;
 } DebounceConfig_t;
 
+typedef struct {
+  // log2 of the number of values that are averaged together
+  uint8_t oversample;
+  // Q15 weight given to each new value, 0 disables smoothing
+  uint16_t smoothing;
+} AxisFilter_t;
+typedef struct {
+  AxisFilter_t lt;
+  AxisFilter_t rt;
+  AxisFilter_t l_x;
+  AxisFilter_t l_y;
+  AxisFilter_t r_x;
+  AxisFilter_t r_y;
+} FilterConfig_t;
+
+typedef struct {
+  uint8_t lt;
+  uint8_t rt;
+  uint8_t l_x;
+  uint8_t l_y;
+  uint8_t r_x;
+  uint8_t r_y;
+} CurveConfig_t;
+
+typedef struct {
+  uint8_t latchPin;
+  // The number of chained registers
+  uint8_t count;
+  uint8_t bindings[XBOX_BTN_COUNT];
+} ShiftRegisterConfig_t;
+
+typedef struct {
+  // S0 to S3, a CD4051 only uses the first three
+  uint8_t select[4];
+  // The analog pin that the common output is connected to
+  uint8_t pin;
+  // How long the output takes to settle after changing channel
+  uint8_t settleMicros;
+} MuxConfig_t;
+
+#define MATRIX_MAX_ROWS 8
+#define MATRIX_MAX_COLUMNS 8
+typedef struct {
+  uint8_t rows[MATRIX_MAX_ROWS];
+  uint8_t columns[MATRIX_MAX_COLUMNS];
+  // Is there a diode in series with every button
+  bool diodes;
+  // row * MATRIX_MAX_COLUMNS + column
+  uint8_t bindings[XBOX_BTN_COUNT];
+} MatrixConfig_t;
+
+typedef struct {
+  uint8_t pinA;
+  uint8_t pinB;
+  // Counts every edge on both pins, so this is 4x the pulses per revolution
+  uint16_t countsPerRevolution;
+  // The speed that pushes r_x all the way
+  uint8_t fullSpeedRPM;
+} EncoderConfig_t;
+
+typedef struct {
+  // Goes high when the DMP has a packet ready, or INVALID_PIN to poll instead
+  uint8_t intPin;
+  // Packets per second, up to 200
+  uint8_t rate;
+} MPU6050Config_t;
+
 typedef struct {
   MainConfig_t main;
   Pins_t pins;
@@ -133,6 +201,15 @@ typedef struct {
   uint8_t pinsSP;
   AxisScaleConfig_t axisScale;
   DebounceConfig_t debounce;
+  FilterConfig_t filter;
+  CurveConfig_t curves;
+  uint8_t analogDetectThreshold;
+  ShiftRegisterConfig_t shiftRegister;
+  MuxConfig_t mux;
+  MatrixConfig_t matrix;
+  EncoderConfig_t encoder;
+  uint8_t neck;
+  MPU6050Config_t mpu6050;
 } Configuration_t;
 
 #pragma pack(pop)
\ No newline at end of file
@@ -1,7 +1,7 @@
 #pragma once
 #include "../leds/led_colours.h"
 #include "./defines.h"
-#define CONFIG_VERSION 15
+#define CONFIG_VERSION 25
 #define TILT_SENSOR NONE
 #define DEVICE_TYPE DIRECT
 #define OUTPUT_TYPE XINPUT_GUITAR_HERO_GUITAR
@@ -13,6 +13,9 @@
 #define TILT_SENSITIVITY 3000
 #define STRUM_DEBOUNCE 20
 #define BUTTON_DEBOUNCE 5
+#define DEBOUNCE_MODE DEBOUNCE_LOCKOUT
+// How far an analog pin has to move (out of 1024) before it is detected
+#define ANALOG_DETECT_THRESHOLD 10
 
 #define FRET_MODE LEDS_DISABLED
 #define COLOUR(col)                                                            \
@@ -49,6 +52,8 @@
 
 // Set this value to define the orientation of your mpu6050
 #define MPU_6050_ORIENTATION X
+// How often the mpu6050 gives a new tilt reading (Hz)
+#define MPU_6050_RATE 30
 #define TEST_PINS                                                              \
   {                                                                            \
     19, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,       \
@@ -89,10 +94,47 @@
         DEFAULT_AXIS_SCALE                                                     \
   }
 #define DEFAULT_DEBOUNCE                                                       \
-  { BUTTON_DEBOUNCE, STRUM_DEBOUNCE, false }
+  { BUTTON_DEBOUNCE, STRUM_DEBOUNCE, false, DEBOUNCE_MODE }
+#define DEFAULT_FILTER                                                         \
+  { {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0} }
+#define DEFAULT_CURVES                                                         \
+  {                                                                            \
+    CURVE_LINEAR, CURVE_LINEAR, CURVE_LINEAR, CURVE_LINEAR, CURVE_LINEAR,      \
+        CURVE_LINEAR                                                           \
+  }
+#define DEFAULT_SHIFT_REGISTER                                                 \
+  {                                                                            \
+    INVALID_PIN, 1, {                                                          \
+      INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,         \
+          INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,     \
+          INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,     \
+          INVALID_PIN                                                          \
+    }                                                                          \
+  }
+#define DEFAULT_MUX                                                            \
+  { {INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN}, INVALID_PIN, 10 }
+#define DEFAULT_MATRIX                                                         \
+  {                                                                            \
+    {INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,          \
+     INVALID_PIN, INVALID_PIN, INVALID_PIN},                                   \
+        {INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,      \
+         INVALID_PIN, INVALID_PIN, INVALID_PIN},                               \
+        false, {                                                               \
+      INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,         \
+          INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,     \
+          INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN, INVALID_PIN,     \
+          INVALID_PIN                                                          \
+    }                                                                          \
+  }
+#define DEFAULT_ENCODER                                                        \
+  { INVALID_PIN, INVALID_PIN, 2400, 60 }
+#define DEFAULT_MPU6050                                                        \
+  { INVALID_PIN, MPU_6050_RATE }
 #define DEFAULT_CONFIG                                                         \
   {                                                                            \
     DEFAULT_CONFIG_MAIN, PINS, DEFAULT_THRESHOLDS, KEYS, LED_PINS,             \
         DEFAULT_MIDI, {false}, INVALID_PIN, DEFAULT_AXIS_SCALES,               \
-        DEFAULT_DEBOUNCE                                                       \
+        DEFAULT_DEBOUNCE, DEFAULT_FILTER, DEFAULT_CURVES,                      \
+        ANALOG_DETECT_THRESHOLD, DEFAULT_SHIFT_REGISTER, DEFAULT_MUX,          \
+        DEFAULT_MATRIX, DEFAULT_ENCODER, NO_NECK, DEFAULT_MPU6050              \
   }
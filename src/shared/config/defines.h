@@ -5,9 +5,11 @@
 #define REAL_DRUM_SUBTYPE 8
 // Tilt detection
 enum TiltType { NO_TILT, MPU_6050, DIGITAL, ANALOGUE };
+// Guitar necks that are read over I2C
+enum NeckType { NO_NECK, GH5_NECK };
 
 // Input types
-enum InputType { WII = 1, DIRECT, PS2 };
+enum InputType { WII = 1, DIRECT, PS2, SHIFT_REGISTER, MATRIX };
 
 enum SubType {
   XINPUT_GAMEPAD = 1,
@@ -67,6 +69,10 @@ enum FirmwareType {
 // Fret Modes
 enum FretLedMode { LEDS_DISABLED, LEDS_INLINE, APA102 };
 
+enum DebounceMode { DEBOUNCE_LOCKOUT, DEBOUNCE_EAGER };
+
+enum ResponseCurve { CURVE_LINEAR, CURVE_EXPONENTIAL, CURVE_S };
+
 enum MidiType { DISABLED, NOTE, CONTROL_COMMAND };
 
 enum PinTypeFlags {
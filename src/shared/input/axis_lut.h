@@ -0,0 +1,145 @@
+#pragma once
+#include "config/config.h"
+#include "config/defines.h"
+#include "controller/controller.h"
+#include "util/util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// Scaling an axis takes a 32 bit multiply and divide, which is slow on the
+// avr. Instead, the response of each axis is worked out once, for a set of
+// evenly spaced inputs (knots), and inputs are interpolated between the two
+// closest knots. The avr doesn't have the ram for a large table, so it uses
+// fewer knots. Each extra bit doubles the knots, and a table costs
+// 2 * (2^bits + 1) + 2^bits / 8 + 8 bytes per axis. With 4 bits (264 bytes for
+// all axes), curved sticks bend too far between knots and most of their
+// segments fall back to the exact maths. 5 bits (468 bytes) keeps every curve
+// in the table, so the 32u4 spends the extra 204 bytes, but the 328p only has
+// 2k of ram to share with everything else.
+#ifndef AXIS_LUT_BITS
+#  if defined(__AVR_ATmega32U4__)
+#    define AXIS_LUT_BITS 5
+#  elif defined(__AVR__)
+#    define AXIS_LUT_BITS 4
+#  else
+#    define AXIS_LUT_BITS 8
+#  endif
+#endif
+#define AXIS_LUT_SEGMENTS (1 << AXIS_LUT_BITS)
+#define AXIS_LUT_SHIFT (16 - AXIS_LUT_BITS)
+// How far an interpolated value may be from the exact one, out of 65536
+#define AXIS_LUT_MAX_ERROR 128
+// initAxisLUT checks this many points in each segment. The worst point can
+// fall between two of them, so they are held to a slightly tighter limit.
+#define AXIS_LUT_CHECK_BITS 4
+#define AXIS_LUT_CHECKS (1 << AXIS_LUT_CHECK_BITS)
+#define AXIS_LUT_CHECK_ERROR (AXIS_LUT_MAX_ERROR - 4)
+typedef struct {
+  int16_t knots[AXIS_LUT_SEGMENTS + 1];
+  // Segments that the axis starts or stops clamping in aren't a straight
+  // line, so they are worked out exactly instead.
+  uint8_t exact[(AXIS_LUT_SEGMENTS + 7) / 8];
+  AxisScale_t scale;
+  uint8_t curve;
+  bool unipolar;
+} AxisLUT_t;
+AxisLUT_t axisLUTs[XBOX_AXIS_COUNT];
+
+// Apply a response curve to a value between 0 and 65535
+uint16_t applyCurve(uint8_t curve, uint32_t x) {
+  uint32_t x2 = (x * x) >> 16;
+  switch (curve) {
+  case CURVE_EXPONENTIAL:
+    return x2;
+  case CURVE_S:
+    // Rounding can push this one past the top of the range
+    x = 3 * x2 - 2 * ((x2 * x) >> 16);
+    return x > UINT16_MAX ? UINT16_MAX : x;
+  }
+  return x;
+}
+// Scale a value the slow way. Inputs can go one past INT16_MAX so that the
+// last knot can be calculated.
+int32_t scaleAxisUnclamped(AxisScale_t *scale, int32_t value) {
+  int32_t val = value;
+  val -= scale->offset;
+  val *= scale->multiplier;
+  val /= 1024;
+  val += INT16_MIN;
+  return val;
+}
+int16_t scaleAxisExact(AxisLUT_t *lut, int32_t value) {
+  int32_t val = scaleAxisUnclamped(&lut->scale, value);
+  if (val > INT16_MAX) val = INT16_MAX;
+  if (val < INT16_MIN) val = INT16_MIN;
+  if (lut->curve == CURVE_LINEAR) { return val; }
+  if (lut->unipolar) {
+    // Triggers rest at INT16_MIN, so curve the whole range
+    return applyCurve(lut->curve, val - INT16_MIN) + INT16_MIN;
+  }
+  // Sticks rest at 0, so curve each direction separately
+  uint32_t mag = val < 0 ? -val * 2 : val * 2;
+  if (mag > UINT16_MAX) { mag = UINT16_MAX; }
+  int32_t curved = applyCurve(lut->curve, mag) / 2;
+  return val < 0 ? -curved : curved;
+}
+// Interpolate between the two knots around x. The position within a segment
+// and the difference between the knots both fit in 16 bits, so the avr only
+// needs a 16x16 multiply.
+int16_t interpolateAxis(AxisLUT_t *lut, uint16_t x) {
+  uint8_t segment = x >> AXIS_LUT_SHIFT;
+  int16_t frac = x & ((1 << AXIS_LUT_SHIFT) - 1);
+  int16_t start = lut->knots[segment];
+  int16_t diff = lut->knots[segment + 1] - start;
+  return start + (((int32_t)diff * frac) >> AXIS_LUT_SHIFT);
+}
+void setAxisExact(AxisLUT_t *lut, uint8_t segment) {
+  bit_set(lut->exact[segment >> 3], segment & 7);
+}
+void initAxisLUT(uint8_t axis, AxisScale_t *scale, uint8_t curve,
+                 bool unipolar) {
+  AxisLUT_t *lut = &axisLUTs[axis];
+  lut->scale = *scale;
+  lut->curve = curve;
+  lut->unipolar = unipolar;
+  memset(lut->exact, 0, sizeof(lut->exact));
+  int32_t last = 0;
+  for (uint16_t i = 0; i <= AXIS_LUT_SEGMENTS; i++) {
+    int32_t input = INT16_MIN + ((int32_t)i << AXIS_LUT_SHIFT);
+    lut->knots[i] = scaleAxisExact(lut, input);
+    int32_t val = scaleAxisUnclamped(scale, input);
+    if (i && ((val > INT16_MAX) != (last > INT16_MAX) ||
+              (val < INT16_MIN) != (last < INT16_MIN))) {
+      setAxisExact(lut, i - 1);
+    }
+    last = val;
+  }
+  // Check a few points within each segment against the exact value, and work
+  // out any segment that is too far off exactly instead. Linear segments are
+  // only ever off by rounding, but curves can bend too far between knots.
+  for (uint16_t i = 0; i < AXIS_LUT_SEGMENTS; i++) {
+    int32_t diff = (int32_t)lut->knots[i + 1] - lut->knots[i];
+    if (diff > INT16_MAX || diff < INT16_MIN) {
+      setAxisExact(lut, i);
+      continue;
+    }
+    for (uint8_t j = 1; j < AXIS_LUT_CHECKS; j++) {
+      uint16_t x = ((uint32_t)i << AXIS_LUT_SHIFT) +
+                   ((uint32_t)j << (AXIS_LUT_SHIFT - AXIS_LUT_CHECK_BITS));
+      int32_t error = (int32_t)interpolateAxis(lut, x) -
+                      scaleAxisExact(lut, (int32_t)x + INT16_MIN);
+      if (error > AXIS_LUT_CHECK_ERROR || error < -AXIS_LUT_CHECK_ERROR) {
+        setAxisExact(lut, i);
+      }
+    }
+  }
+}
+int16_t lookupAxis(uint8_t axis, int16_t value) {
+  AxisLUT_t *lut = &axisLUTs[axis];
+  uint16_t x = value - INT16_MIN;
+  uint8_t segment = x >> AXIS_LUT_SHIFT;
+  if (bit_check(lut->exact[segment >> 3], segment & 7)) {
+    return scaleAxisExact(lut, value);
+  }
+  return interpolateAxis(lut, x);
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "config/defines.h"
+#include "controller/controller.h"
+#include "pins/pins.h"
+#include "timer/timer.h"
+#include "util/util.h"
+#include <stdbool.h>
+#include <stdint.h>
+// All buttons are debounced together using vertical counters. Each plane holds
+// one bit of a per button counter, so a single 16 bit operation updates all 16
+// buttons at once. The counters track how many milliseconds have passed since
+// a button last changed, and saturate at 255.
+#define DEBOUNCE_PLANES 8
+#define DEBOUNCE_MAX_TIME ((1 << DEBOUNCE_PLANES) - 1)
+// Buttons with the same debounce time are grouped, normally there is one group
+// for buttons and one for the strum
+#define DEBOUNCE_GROUPS 4
+typedef struct {
+  uint8_t time;
+  uint16_t mask;
+} DebounceGroup_t;
+uint16_t debouncePlanes[DEBOUNCE_PLANES];
+uint16_t debounceState;
+// The buttons that changed during the last call to debounceButtons
+uint16_t debounceChanged;
+DebounceGroup_t debounceGroups[DEBOUNCE_GROUPS];
+uint8_t debounceGroupCount;
+bool debounceMergedStrum;
+uint8_t debounceMode;
+unsigned long debounceLastMillis;
+
+// Add one to every counter that has not saturated yet
+static inline void debounceIncrement(void) {
+  uint16_t carry = 0xFFFF;
+  for (uint8_t i = 0; i < DEBOUNCE_PLANES; i++) { carry &= debouncePlanes[i]; }
+  carry = ~carry;
+  for (uint8_t i = 0; i < DEBOUNCE_PLANES; i++) {
+    uint16_t next = debouncePlanes[i] & carry;
+    debouncePlanes[i] ^= carry;
+    carry = next;
+  }
+}
+// Returns a mask of every button with a counter greater than time, comparing
+// from the most significant plane down.
+static inline uint16_t debounceGreaterThan(uint8_t time) {
+  uint16_t greater = 0;
+  uint16_t equal = 0xFFFF;
+  for (int8_t i = DEBOUNCE_PLANES - 1; i >= 0; i--) {
+    if (bit_check(time, i)) {
+      equal &= debouncePlanes[i];
+    } else {
+      greater |= equal & debouncePlanes[i];
+      equal &= ~debouncePlanes[i];
+    }
+  }
+  return greater;
+}
+static inline void debounceReset(uint16_t mask) {
+  for (uint8_t i = 0; i < DEBOUNCE_PLANES; i++) { debouncePlanes[i] &= ~mask; }
+}
+// Buttons that aren't in a group never change, so buttons that don't come from
+// a pin need to be added here. A button that is already in a group keeps it.
+void debounceAddButton(uint8_t offset, uint8_t time) {
+  for (uint8_t group = 0; group < debounceGroupCount; group++) {
+    if (bit_check(debounceGroups[group].mask, offset)) return;
+  }
+  // The counters can't count past DEBOUNCE_MAX_TIME, so clamp the time to
+  // something that can still expire.
+  if (time >= DEBOUNCE_MAX_TIME) { time = DEBOUNCE_MAX_TIME - 1; }
+  uint8_t group = 0;
+  while (group < debounceGroupCount && debounceGroups[group].time != time) {
+    group++;
+  }
+  if (group == DEBOUNCE_GROUPS) {
+    group--;
+  } else if (group == debounceGroupCount) {
+    debounceGroups[debounceGroupCount++] = (DebounceGroup_t){time, 0};
+  }
+  debounceGroups[group].mask |= _BV(offset);
+}
+void initDebounce(Pin_t *pins, uint8_t count, bool mergedStrum,
+                  uint8_t mode) {
+  debounceGroupCount = 0;
+  debounceState = 0;
+  debounceMergedStrum = mergedStrum;
+  debounceMode = mode;
+  debounceLastMillis = millis();
+  // Start with every counter saturated, so that the first press is never held
+  // back
+  memset(debouncePlanes, 0xFF, sizeof(debouncePlanes));
+  for (uint8_t i = 0; i < count; i++) {
+    debounceAddButton(pins[i].offset, pins[i].milliDeBounce);
+  }
+}
+// Takes the raw state of every button at a time in milliseconds, and returns
+// the debounced state.
+// In DEBOUNCE_LOCKOUT mode, a change is reported straight away, and then that
+// button is locked for its debounce time.
+// In DEBOUNCE_EAGER mode, a press is always reported straight away, but a
+// release is only reported once the button has read as released for the whole
+// debounce time, so chatter while releasing never produces an extra press.
+uint16_t debounceButtonsAt(uint16_t raw, unsigned long now) {
+  unsigned long elapsed = now - debounceLastMillis;
+  debounceLastMillis = now;
+  if (elapsed >= DEBOUNCE_MAX_TIME) {
+    memset(debouncePlanes, 0xFF, sizeof(debouncePlanes));
+  } else {
+    while (elapsed--) { debounceIncrement(); }
+  }
+  uint16_t ready = 0;
+  for (uint8_t i = 0; i < debounceGroupCount; i++) {
+    ready |= debounceGreaterThan(debounceGroups[i].time) &
+             debounceGroups[i].mask;
+  }
+  // If strum is merged, then up and down share the counter from down
+  if (debounceMergedStrum) {
+    bit_write(bit_check(ready, XBOX_DPAD_DOWN), ready, XBOX_DPAD_UP);
+  }
+  uint16_t changed;
+  uint16_t reset;
+  if (debounceMode == DEBOUNCE_EAGER) {
+    // Holding a button keeps its counter at zero, so the counter measures how
+    // long it has been released for.
+    uint16_t eager = 0xFFFF;
+    reset = raw;
+    if (debounceMergedStrum) {
+      // A merged strum still needs to wait for the shared counter, otherwise
+      // the bar bouncing off the opposite switch would count as a strum.
+      eager &= ~(_BV(XBOX_DPAD_UP) | _BV(XBOX_DPAD_DOWN));
+      if (raw & (_BV(XBOX_DPAD_UP) | _BV(XBOX_DPAD_DOWN))) {
+        bit_set(reset, XBOX_DPAD_DOWN);
+      }
+    }
+    changed = (raw & ~debounceState & (eager | ready)) |
+              (~raw & debounceState & ready);
+  } else {
+    changed = (raw ^ debounceState) & ready;
+    reset = changed;
+  }
+  if (debounceMergedStrum && bit_check(changed, XBOX_DPAD_UP)) {
+    bit_clear(changed, XBOX_DPAD_DOWN);
+    bit_set(reset, XBOX_DPAD_DOWN);
+  }
+  debounceState ^= changed;
+  debounceChanged = changed;
+  debounceReset(reset);
+  return debounceState;
+}
+uint16_t debounceButtons(uint16_t raw) {
+  return debounceButtonsAt(raw, millis());
+}
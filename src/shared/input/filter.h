@@ -0,0 +1,73 @@
+#pragma once
+#include "config/config.h"
+#include "controller/controller.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// Analog axes can be filtered to hide jitter, which would otherwise change the
+// report on nearly every poll. Each axis first averages 2^oversample values
+// (holding the last average in between), and then goes through a first order
+// IIR filter where smoothing is the Q15 weight given to each new value.
+#define FILTER_MAX_OVERSAMPLE 4
+typedef struct {
+  int32_t sum;
+  uint8_t count;
+  int16_t decimated;
+  bool primed;
+  // Q15 fixed point, so the filter doesn't lose the fractional part
+  int32_t state;
+} AxisFilterState_t;
+AxisFilter_t filters[XBOX_AXIS_COUNT];
+AxisFilterState_t filterStates[XBOX_AXIS_COUNT];
+
+void initFilters(Configuration_t *config) {
+  memcpy(filters, &config->filter, sizeof(filters));
+  memset(filterStates, 0, sizeof(filterStates));
+  for (uint8_t i = 0; i < XBOX_AXIS_COUNT; i++) {
+    if (filters[i].oversample > FILTER_MAX_OVERSAMPLE) {
+      filters[i].oversample = FILTER_MAX_OVERSAMPLE;
+    }
+    // A weight of 1.0 can't be represented, and would mean no filtering anyway
+    if (filters[i].smoothing > INT16_MAX) { filters[i].smoothing = 0; }
+  }
+}
+int16_t filterAxis(uint8_t axis, int16_t value) {
+  AxisFilter_t *filter = &filters[axis];
+  AxisFilterState_t *state = &filterStates[axis];
+  if (filter->oversample) {
+    state->sum += value;
+    if (++state->count < (1 << filter->oversample)) {
+      return state->decimated;
+    }
+    value = state->sum >> filter->oversample;
+    state->sum = 0;
+    state->count = 0;
+  }
+  if (!state->primed) {
+    // Start from the first value, instead of slowly rising from zero
+    state->state = (int32_t)value * 32768;
+    state->primed = true;
+  }
+  if (filter->smoothing) {
+    // Both terms are below 2^16 and 2^15, so this can't overflow
+    int32_t error = value - (state->state >> 15);
+    state->state += (int32_t)filter->smoothing * error;
+    value = state->state >> 15;
+  }
+  state->decimated = value;
+  return value;
+}
+// The delay added by the filter on an axis, in 1/256ths of a tick. Averaging
+// and holding delays by 2^oversample - 1 ticks on average, and the IIR
+// filter delays by (1 - smoothing) / smoothing of its (decimated) updates.
+uint16_t getFilterDelay(uint8_t axis) {
+  AxisFilter_t *filter = &filters[axis];
+  uint32_t ticks = 1 << filter->oversample;
+  uint32_t delay = (ticks - 1) << 8;
+  if (filter->smoothing) {
+    uint32_t iir = ((uint32_t)(32768 - filter->smoothing)) << 8;
+    delay += ticks * (iir / filter->smoothing);
+  }
+  if (delay > UINT16_MAX) { delay = UINT16_MAX; }
+  return delay;
+}
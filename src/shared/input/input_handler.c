@@ -1,9 +1,13 @@
 #include "input_handler.h"
+#include "debounce.h"
 #include "eeprom/eeprom.h"
 #include "i2c/i2c.h"
 #include "inputs/direct.h"
+#include "inputs/encoder.h"
 #include "inputs/guitar.h"
+#include "inputs/matrix.h"
 #include "inputs/ps2_cnt.h"
+#include "inputs/shift_register.h"
 #include "inputs/wii_ext.h"
 #include "leds/leds.h"
 #include "output/descriptors.h"
@@ -13,76 +17,154 @@
 #include <stdlib.h>
 void (*tick_function)(Controller_t *);
 bool (*read_button_function)(Pin_t pin);
+uint16_t (*read_buttons_function)(void);
+uint16_t (*read_input_buttons_function)(void);
 int joyThreshold;
 int triggerThreshold;
 bool mapJoyLeftDpad;
 bool mapStartSelectHome;
 bool mergedStrum;
 Pin_t pinData[XBOX_BTN_COUNT] = {};
+#ifdef MULTI_ADAPTOR
+Controller_t extraControllers[EXTRA_CONTROLLERS];
+#endif
+// Everything that this config needs to do each tick, in order. This is worked
+// out in initInputs, so that ticks don't need to keep checking the config.
+#define MAX_INPUT_STAGES 8
+void (*inputStages[MAX_INPUT_STAGES])(Controller_t *);
+uint8_t inputStageCount;
+// The most recent button edge, and when it happened
+uint16_t lastEdgeButtons;
+unsigned long lastEdgeMicros;
+// Used by inputs that don't have their own way of reading every button at once
+uint16_t readButtonsFromPins(void) {
+  uint16_t ret = 0;
+  for (uint8_t i = 0; i < validPins; i++) {
+    if (read_button_function(pinData[i])) { bit_set(ret, pinData[i].offset); }
+  }
+  return ret;
+}
+// The neck frets are added to whatever the input reads, so that they are
+// debounced with everything else
+uint16_t readButtonsWithNeck(void) {
+  return read_input_buttons_function() | readGH5NeckButtons();
+}
+void tickButtons(Controller_t *controller) {
+  controller->buttons = debounceButtons(read_buttons_function());
+  if (debounceChanged) {
+    lastEdgeButtons = debounceChanged;
+    lastEdgeMicros = micros();
+  }
+}
+#ifndef __AVR__
+// Debounce every sample taken since the last tick, so that edges are seen at
+// the time they were sampled instead of the time of the tick
+void tickSampledButtons(Controller_t *controller) {
+  uint16_t buttons;
+  unsigned long ms;
+  unsigned long us;
+  uint16_t analog = readAnalogButtons();
+  if (neckEnabled) { analog |= readGH5NeckButtons(); }
+  while (readPortSample(&buttons, &ms, &us)) {
+    debounceButtonsAt(buttons | analog, ms);
+    if (debounceChanged) {
+      lastEdgeButtons = debounceChanged;
+      lastEdgeMicros = us;
+    }
+  }
+  controller->buttons = debounceState;
+}
+#endif
+void tickJoyToDpad(Controller_t *controller) {
+  CHECK_JOY(l_x, XBOX_DPAD_LEFT, XBOX_DPAD_RIGHT);
+  CHECK_JOY(l_y, XBOX_DPAD_DOWN, XBOX_DPAD_UP);
+}
+void tickStartSelectHome(Controller_t *controller) {
+  if (bit_check(controller->buttons, XBOX_START) &&
+      bit_check(controller->buttons, XBOX_BACK)) {
+    bit_clear(controller->buttons, XBOX_START);
+    bit_clear(controller->buttons, XBOX_BACK);
+    bit_set(controller->buttons, XBOX_HOME);
+  }
+}
+void addInputStage(void (*stage)(Controller_t *)) {
+  if (stage) { inputStages[inputStageCount++] = stage; }
+}
 void initInputs(Configuration_t *config) {
+  tick_function = NULL;
   mapJoyLeftDpad = config->main.mapLeftJoystickToDPad;
   mapStartSelectHome = config->main.mapStartSelectToHome;
   mergedStrum = typeIsGuitar && config->debounce.combinedStrum;
+  read_buttons_function = readButtonsFromPins;
   setupADC();
   switch (config->main.inputType) {
   case WII:
     initWiiExtensions(config);
     tick_function = tickWiiExtInput;
-    read_button_function = readWiiButton;
+    read_buttons_function = readWiiButtons;
     break;
   case DIRECT:
     read_button_function = digitalReadPin;
+    read_buttons_function = readDirectButtons;
     break;
   case PS2:
     initPS2CtrlInput(config);
     read_button_function = readPS2Button;
     tick_function = tickPS2CtrlInput;
     break;
+  case SHIFT_REGISTER:
+    initShiftRegister(config);
+    read_buttons_function = readShiftRegisterButtons;
+    break;
+  case MATRIX:
+    initMatrix(config);
+    read_buttons_function = readMatrixButtons;
+    break;
   }
-  if (config->main.inputType != PS2 && config->main.fretLEDMode == APA102) {
+  if (config->main.inputType == SHIFT_REGISTER) {
+    // APA102s can share the slower clock. They use mode 3, and the shift
+    // registers switch to mode 2 for each read.
+    spi_begin(SHIFT_REGISTER_CLOCK, true, true, false);
+  } else if (config->main.inputType != PS2 &&
+             config->main.fretLEDMode == APA102) {
     spi_begin(F_CPU / 2, true, true, false);
   }
-  if (config->main.inputType == WII || config->main.tiltType == MPU_6050) {
+  neckEnabled = typeIsGuitar && config->neck == GH5_NECK;
+  if (config->main.inputType == WII || config->main.tiltType == MPU_6050 ||
+      neckEnabled) {
     twi_init();
   }
   initDirectInput(config);
+  initDebounce(pinData, validPins, mergedStrum, config->debounce.mode);
+  if (neckEnabled) {
+    initGH5Neck(config);
+    read_input_buttons_function = read_buttons_function;
+    read_buttons_function = readButtonsWithNeck;
+  }
   initGuitar(config);
+  initEncoder(config);
   joyThreshold = config->axis.joyThreshold << 8;
   triggerThreshold = config->axis.triggerThreshold;
+  inputStageCount = 0;
+  addInputStage(tick_function);
+  addInputStage(tickDirectInput);
+  if (encoderEnabled) { addInputStage(tickEncoder); }
+#ifndef __AVR__
+  if (config->main.inputType == DIRECT && startPortSampler()) {
+    addInputStage(tickSampledButtons);
+  } else {
+    addInputStage(tickButtons);
+  }
+#else
+  addInputStage(tickButtons);
+#endif
+  if (mapJoyLeftDpad) { addInputStage(tickJoyToDpad); }
+  if (mapStartSelectHome) { addInputStage(tickStartSelectHome); }
+  if (neckEnabled) { addInputStage(tickGH5Neck); }
+  if (typeIsGuitar) { addInputStage(tick); }
 }
 void tickInputs(Controller_t *controller) {
-  if (tick_function) { tick_function(controller); }
-  tickDirectInput(controller);
-  Pin_t* pin;
-  Pin_t* pin2;
-  for (uint8_t i = 0; i < validPins; i++) {
-    pin = &pinData[i];
-    pin2 = &pinData[i];
-    // If strum is merged, then we want to grab debounce data from the same button for both
-    if (mergedStrum && i == XBOX_DPAD_UP) {
-      pin2 = &pinData[XBOX_DPAD_DOWN];
-    }
-    if (millis() - pin2->lastMillis > pin2->milliDeBounce) {
-      bool val = read_button_function(*pin);
-      if (val != (bit_check(controller->buttons, pin->offset))) {
-        pin2->lastMillis = millis();
-        bit_write(val, controller->buttons, pin->offset);
-      }
-    }
-  }
-  if (mapJoyLeftDpad) {
-    CHECK_JOY(l_x, XBOX_DPAD_LEFT, XBOX_DPAD_RIGHT);
-    CHECK_JOY(l_y, XBOX_DPAD_DOWN, XBOX_DPAD_UP);
-  }
-  if (mapStartSelectHome) {
-    if (bit_check(controller->buttons, XBOX_START) &&
-        bit_check(controller->buttons, XBOX_BACK)) {
-      bit_clear(controller->buttons, XBOX_START);
-      bit_clear(controller->buttons, XBOX_BACK);
-      bit_set(controller->buttons, XBOX_HOME);
-    }
-  }
-  tickGuitar(controller);
+  for (uint8_t i = 0; i < inputStageCount; i++) { inputStages[i](controller); }
 }
 uint8_t getVelocity(Controller_t *controller, uint8_t offset) {
   if (offset < XBOX_BTN_COUNT) {
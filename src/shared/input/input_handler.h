@@ -16,6 +16,14 @@ void initInputs(Configuration_t* config);
 void tickInputs(Controller_t* controller);
 void setSP(bool sp);
 uint8_t getVelocity(Controller_t* controller, uint8_t offset);
+uint16_t getFilterDelay(uint8_t axis);
 extern uint8_t detectedPin;
+extern uint16_t lastEdgeButtons;
+extern unsigned long lastEdgeMicros;
 extern int16_t analogueData[XBOX_AXIS_COUNT];
-extern Pin_t pinData[XBOX_BTN_COUNT];
\ No newline at end of file
+extern Pin_t pinData[XBOX_BTN_COUNT];
+#ifdef MULTI_ADAPTOR
+// The other players on the multi adaptor, from a PS2 multitap
+#  define EXTRA_CONTROLLERS 3
+extern Controller_t extraControllers[EXTRA_CONTROLLERS];
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 #include "controller/controller.h"
 #include "eeprom/eeprom.h"
+#include "input/axis_lut.h"
+#include "input/filter.h"
 #include "guitar.h"
 #include "output/descriptors.h"
 #include "pins/pins.h"
@@ -11,34 +13,51 @@ uint8_t detectedPin = 0xff;
 bool lookingForDigital = false;
 bool lookingForAnalog = false;
 int lastAnalogValue[NUM_ANALOG_INPUTS];
-bool lastDigitalValue[NUM_DIGITAL_PINS];
-AnalogInfo_t joyData[NUM_ANALOG_INPUTS];
+uint8_t analogDetectThreshold;
+AnalogInfo_t joyData[MAX_ANALOG_INPUTS];
 int16_t analogueData[XBOX_AXIS_COUNT];
 bool usingI2C;
 bool usingSPI;
 uint8_t spPin;
-uint8_t tiltType;
 uint8_t drumVelocity[8];
 AxisScale_t scales[6];
+// Buttons that are driven by an analog pin (drums) can't be read from a port
+Pin_t analogButtons[XBOX_BTN_COUNT];
+uint8_t validAnalogButtons;
+// Axes are set up first, so joyData holds every axis and then every drum pad
+uint8_t validAxes;
 void reinitDirectInput(void) {
   if (spPin != INVALID_PIN) { pinMode(spPin, OUTPUT); }
   for (int i = 0; i < validPins; i++) {
     Pin_t p = pinData[i];
+    if (isMuxPin(p.pin)) continue;
     pinMode(p.pin,
             (p.eq || (p.analogOffset != INVALID_PIN)) ? INPUT : INPUT_PULLUP);
   }
 }
 void initDirectInput(Configuration_t *config) {
   usingI2C =
-      (config->main.tiltType == MPU_6050 || config->main.inputType == WII);
+      (config->main.tiltType == MPU_6050 || config->main.inputType == WII ||
+       (typeIsGuitar && config->neck == GH5_NECK));
   usingSPI =
-      (config->main.fretLEDMode == APA102) || config->main.inputType == PS2;
+      (config->main.fretLEDMode == APA102) || config->main.inputType == PS2 ||
+      config->main.inputType == SHIFT_REGISTER;
   spPin = config->pinsSP;
-  tiltType = config->main.tiltType;
+  analogDetectThreshold = config->analogDetectThreshold;
   uint8_t *pins = (uint8_t *)&config->pins;
   memcpy(scales, &config->axisScale, sizeof(scales));
+  uint8_t *curves = (uint8_t *)&config->curves;
+  for (uint8_t i = 0; i < XBOX_AXIS_COUNT; i++) {
+    // Triggers center at -32767, sticks center at 0. Whammy works similar to
+    // a trigger, so we also count it here.
+    bool unipolar = i < 2 || (typeIsGuitar && i == XBOX_WHAMMY);
+    initAxisLUT(i, &scales[i], curves[i], unipolar);
+  }
+  initFilters(config);
   validPins = 0;
+  validAnalogButtons = 0;
   setUpValidPins(config);
+  validAxes = validAnalog;
   if (config->pinsSP != INVALID_PIN) { pinMode(config->pinsSP, OUTPUT); }
   for (size_t i = 0; i < XBOX_BTN_COUNT; i++) {
     if (config->main.inputType == DIRECT) {
@@ -47,12 +66,16 @@ void initDirectInput(Configuration_t *config) {
         Pin_t pin = setUpDigital(
             config, pins[i], i,
             is_fret && config->main.fretLEDMode == LEDS_INLINE, false);
-        if (typeIsDrum && is_fret && pins[i] >= PIN_A0) {
+        if (isMuxPin(pins[i]) ||
+            (typeIsDrum && is_fret && pins[i] >= PIN_A0)) {
           // We should probably keep a list of drum specific buttons, instead of
-          // using isfret
+          // using isfret. Multiplexer inputs can only be read as analog, so
+          // they are always treated this way.
           // ADC is 10 bit, thereshold is specified as an 8 bit value, so shift
           // it
           setUpAnalogDigitalPin(&pin, pins[i], config->axis.drumThreshold << 3);
+          // Multiplexer inputs can't be read if there isn't a multiplexer
+          if (pin.analogOffset == INVALID_PIN) continue;
         } else {
           pinMode(pins[i], pin.eq ? INPUT : INPUT_PULLUP);
           if (typeIsGuitar && (i == XBOX_DPAD_DOWN || i == XBOX_DPAD_UP)) {
@@ -70,6 +93,30 @@ void initDirectInput(Configuration_t *config) {
       pinData[validPins++] = pin;
     }
   }
+  if (config->main.inputType == DIRECT) {
+    Pin_t digitalButtons[XBOX_BTN_COUNT];
+    uint8_t validDigitalButtons = 0;
+    for (int i = 0; i < validPins; i++) {
+      if (pinData[i].analogOffset == INVALID_PIN) {
+        digitalButtons[validDigitalButtons++] = pinData[i];
+      } else {
+        analogButtons[validAnalogButtons++] = pinData[i];
+      }
+    }
+    setUpPortScan(digitalButtons, validDigitalButtons);
+  }
+}
+uint16_t readAnalogButtons(void) {
+  uint16_t ret = 0;
+  for (uint8_t i = 0; i < validAnalogButtons; i++) {
+    if (digitalReadPin(analogButtons[i])) {
+      bit_set(ret, analogButtons[i].offset);
+    }
+  }
+  return ret;
+}
+uint16_t readDirectButtons(void) {
+  return readPortScan() | readAnalogButtons();
 }
 bool shouldSkipPin(uint8_t i) {
   // On the 328p, due to an inline LED, it isn't possible to check pin 13, also if debug is turned on then also dont allow uart pins.
@@ -104,13 +151,7 @@ void findDigitalPin(void) {
   if (lookingForDigital) return;
   detectedPin = 0xff;
   stopReading();
-  for (int i = 0; i < NUM_DIGITAL_PINS; i++) {
-    if (!shouldSkipPin(i)) {
-      pinMode(i, INPUT_PULLUP);
-      _delay_us(100);
-      lastDigitalValue[i] = digitalRead(i);
-    }
-  }
+  startPinDetection(shouldSkipPin);
   lookingForDigital = true;
 }
 
@@ -120,19 +161,16 @@ void findAnalogPin(void) {
   stopReading();
   for (int i = 0; i < NUM_ANALOG_INPUTS; i++) {
     pinMode(PIN_A0 + i, INPUT_PULLUP);
-    _delay_us(100);
+  }
+  _delay_us(100);
+  for (int i = 0; i < NUM_ANALOG_INPUTS; i++) {
     lastAnalogValue[i] = analogRead(i);
   }
   lookingForAnalog = true;
 }
 
 void stopSearching(void) {
-  if (lookingForDigital) {
-    for (int i = 0; i < NUM_DIGITAL_PINS; i++) {
-      if (!shouldSkipPin(i)) { pinMode(i, INPUT); }
-      lastDigitalValue[i] = digitalRead(i);
-    }
-  }
+  if (lookingForDigital) { stopPinDetection(); }
   lookingForDigital = lookingForAnalog = false;
 }
 
@@ -143,7 +181,7 @@ void setSP(bool sp) {
 void tickDirectInput(Controller_t *controller) {
   if (lookingForAnalog) {
     for (int i = 0; i < NUM_ANALOG_INPUTS; i++) {
-      if (abs(analogRead(i) - lastAnalogValue[i]) > 10) {
+      if (abs(analogRead(i) - lastAnalogValue[i]) > analogDetectThreshold) {
         detectedPin = i + PIN_A0;
         lookingForAnalog = false;
         return;
@@ -152,49 +190,35 @@ void tickDirectInput(Controller_t *controller) {
     return;
   }
   if (lookingForDigital) {
-    for (int i = 0; i < NUM_DIGITAL_PINS; i++) {
-      if (!shouldSkipPin(i)) {
-        if (digitalRead(i) != lastDigitalValue[i]) {
-          stopSearching();
-          detectedPin = i;
-          lookingForDigital = false;
-          return;
-        }
-      }
+    uint8_t pin = findChangedPin();
+    if (pin != INVALID_PIN) {
+      stopSearching();
+      detectedPin = pin;
     }
     return;
   }
   tickAnalog();
-  AnalogInfo_t info;
+  AnalogInfo_t *info = joyData;
   ControllerCombined_t *combinedController = (ControllerCombined_t *)controller;
-  AxisScale_t scale;
-  for (int8_t i = 0; i < validAnalog; i++) {
-    info = joyData[i];
-    if (info.hasDigital) {
-      drumVelocity[info.offset - 8] = info.value;
+  int16_t deadzone;
+  for (uint8_t i = 0; i < validAxes; i++, info++) {
+    analogueData[info->offset] = info->value;
+    int16_t val = filterAxis(info->offset, info->value);
+    val = lookupAxis(info->offset, val);
+    // The deadzone is a step, so it can't be interpolated by the lookup
+    deadzone = scales[info->offset].deadzone;
+    if (axisLUTs[info->offset].unipolar) {
+      if (val < deadzone) { val = INT16_MIN; }
+    } else if (val < deadzone && val > -deadzone) {
+      val = 0;
+    }
+    if (info->offset >= 2) {
+      combinedController->sticks[info->offset - 2] = val;
     } else {
-      if (i == XBOX_TILT && typeIsGuitar && tiltType == DIGITAL) { continue; }
-      analogueData[info.offset] = info.value;
-      scale = scales[info.offset];
-      int32_t val = info.value;
-      val -= scale.offset;
-      val *= scale.multiplier;
-      val /= 1024;
-      val += INT16_MIN;
-      if (val > INT16_MAX) val = INT16_MAX;
-      if (val < INT16_MIN) val = INT16_MIN;
-      // Triggers center at -32767, sticks center at 0. Whammy works similar to
-      // a trigger, so we also count it here.
-      if (info.offset < 2 || (typeIsGuitar && info.offset == XBOX_WHAMMY)) {
-        if (val < scale.deadzone) { val = INT16_MIN; }
-      } else if (val < scale.deadzone && val > -scale.deadzone) {
-        val = 0;
-      }
-      if (info.offset >= 2) {
-        combinedController->sticks[info.offset - 2] = val;
-      } else {
-        combinedController->triggers[info.offset] = ((uint16_t)val) >> 8;
-      }
+      combinedController->triggers[info->offset] = ((uint16_t)val) >> 8;
     }
   }
+  for (uint8_t i = validAxes; i < validAnalog; i++, info++) {
+    if (info->offset >= 8) { drumVelocity[info->offset - 8] = info->value; }
+  }
 }
@@ -0,0 +1,95 @@
+#pragma once
+#include "config/defines.h"
+#include "controller/controller.h"
+#include "pins/pins.h"
+#include "timer/timer.h"
+#include "util/util.h"
+#include <stdint.h>
+#include <stdlib.h>
+// A quadrature encoder, for turntables and wheels. Both pins interrupt on
+// every edge, so no steps are lost between ticks. The angle within a
+// revolution goes to l_x, and the speed goes to r_x.
+// The speed is measured over at least ENCODER_WINDOW_MS, as a single tick
+// rarely sees more than a step or two.
+#define ENCODER_WINDOW_MS 8
+// Indexed by the last and current state of both pins, gives the direction
+// moved, or 0 for no change or a skipped state
+const int8_t encoderSteps[16] = {0, -1, 1,  0, 1,  0, 0, -1,
+                                 -1, 0, 0, 1, 0, 1, -1, 0};
+Pin_t encoderA;
+Pin_t encoderB;
+volatile int32_t encoderPosition;
+volatile uint8_t encoderState;
+bool encoderEnabled;
+uint16_t encoderCountsPerRev;
+// Counts per millisecond * this gives r_x
+uint32_t encoderVelocityScale;
+int32_t encoderLastPosition;
+unsigned long encoderLastMillis;
+int16_t encoderVelocity;
+void encoderInterrupt(void) {
+  uint8_t state = digitalReadPin(encoderA) << 1 | digitalReadPin(encoderB);
+  encoderPosition += encoderSteps[encoderState << 2 | state];
+  encoderState = state;
+}
+int32_t readEncoderPosition(void) {
+#ifdef __AVR__
+  // This is more than one byte on the AVR, so the interrupt could change it
+  // part way through a read
+  uint8_t oldSREG = SREG;
+  cli();
+  int32_t position = encoderPosition;
+  SREG = oldSREG;
+  return position;
+#else
+  // An aligned 32 bit read is a single load on the pico, so it can't be torn
+  return encoderPosition;
+#endif
+}
+void initEncoder(Configuration_t *config) {
+  encoderEnabled = false;
+  uint8_t pinA = config->encoder.pinA;
+  uint8_t pinB = config->encoder.pinB;
+  if (pinA == INVALID_PIN || pinB == INVALID_PIN) return;
+  encoderCountsPerRev = config->encoder.countsPerRevolution;
+  if (!encoderCountsPerRev) { encoderCountsPerRev = 1; }
+  uint32_t fullSpeed =
+      (uint32_t)encoderCountsPerRev * config->encoder.fullSpeedRPM;
+  if (!fullSpeed) { fullSpeed = 1; }
+  // fullSpeed is in counts per minute, so this is 32767 over the counts per
+  // millisecond at full speed
+  encoderVelocityScale = 32767UL * 60000 / fullSpeed;
+  pinMode(pinA, INPUT_PULLUP);
+  pinMode(pinB, INPUT_PULLUP);
+  encoderA = setUpDigital(config, pinA, 0, true, false);
+  encoderB = setUpDigital(config, pinB, 0, true, false);
+  encoderState = digitalReadPin(encoderA) << 1 | digitalReadPin(encoderB);
+  encoderPosition = 0;
+  encoderLastPosition = 0;
+  encoderLastMillis = millis();
+  encoderVelocity = 0;
+  detachInterrupt(pinA);
+  detachInterrupt(pinB);
+  encoderEnabled = attachInterrupt(pinA, encoderInterrupt, CHANGE) &&
+                   attachInterrupt(pinB, encoderInterrupt, CHANGE);
+}
+void tickEncoder(Controller_t *controller) {
+  int32_t position = readEncoderPosition();
+  unsigned long now = millis();
+  unsigned long elapsed = now - encoderLastMillis;
+  if (elapsed >= ENCODER_WINDOW_MS) {
+    int32_t delta = position - encoderLastPosition;
+    uint32_t scale = encoderVelocityScale / elapsed;
+    if (scale && labs(delta) > 32767 / scale) {
+      encoderVelocity = delta < 0 ? -32767 : 32767;
+    } else {
+      encoderVelocity = delta * (int32_t)scale;
+    }
+    encoderLastPosition = position;
+    encoderLastMillis = now;
+  }
+  int32_t angle = position % encoderCountsPerRev;
+  if (angle < 0) { angle += encoderCountsPerRev; }
+  controller->l_x = ((uint32_t)angle << 16) / encoderCountsPerRev + INT16_MIN;
+  controller->r_x = encoderVelocity;
+}
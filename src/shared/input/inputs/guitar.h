@@ -4,6 +4,7 @@
 #include "eeprom/eeprom.h"
 #include "guitar.h"
 #include "i2c/i2c.h"
+#include "input/debounce.h"
 #include "mpu6050/inv_mpu.h"
 #include "mpu6050/inv_mpu_dmp_motion_driver.h"
 #include "mpu6050/mpu_math.h"
@@ -33,30 +34,91 @@ volatile bool ready = false;
 uint8_t mpuOrientation;
 uint8_t tiltPin;
 bool tiltInverted;
-AxisScale_t scale;
+// The DMP is read in the background instead of with dmp_read_fifo, so that it
+// never holds up a tick. Each sample reads how much is in the FIFO, and then
+// reads every packet out of it, one burst each. Only the newest one is used.
+// If the INT pin is wired up, samples are only taken once it says that there
+// is a new packet, otherwise the FIFO is checked at the DMP's rate.
+#define MPU6050_ADDR 0x68
+#define MPU6050_FIFO_COUNT_PTR 0x72
+#define MPU6050_FIFO_PTR 0x74
+// Only the quaternion is enabled, so that is all a packet has in it
+#define MPU6050_PACKET_LENGTH 16
+// The FIFO holds 1024 bytes, past halfway it is about to overflow
+#define MPU6050_FIFO_LIMIT 512
+// Tilt is slow, so it goes after everything else on the bus
+#define MPU6050_PRIORITY 2
+// The fastest that the DMP can put packets in the FIFO
+#define MPU6050_MAX_RATE 200
+// dmp_read_fifo throws out quaternions that aren't close to a length of 1, as
+// a misaligned read gives garbage
+#define MPU6050_QUAT_MIN ((1L << 28) - (1L << 24))
+#define MPU6050_QUAT_MAX ((1L << 28) + (1L << 24))
+TwiDevice_t mpuDevice;
+uint8_t mpuFifoCount[2];
+uint8_t mpuPacket[MPU6050_PACKET_LENGTH];
+bool mpuReadingPacket;
+// Packets still in the FIFO from the last time it was checked
+uint8_t mpuPacketsLeft;
+bool mpuUseInterrupt;
+volatile bool mpuDataReady;
+void mpuInterrupt(void) { mpuDataReady = true; }
+bool mpuSampleDue(void) {
+  if (!mpuUseInterrupt) return twi_startSample(&mpuDevice);
+  if (!mpuDataReady) return false;
+  mpuDataReady = false;
+  return true;
+}
+bool readMPUPacket(void) {
+  long quatMagSq = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t *data = mpuPacket + i * 4;
+    q._l[i] = ((long)data[0] << 24) | ((long)data[1] << 16) |
+              ((long)data[2] << 8) | data[3];
+    long quatQ14 = q._l[i] >> 16;
+    quatMagSq += quatQ14 * quatQ14;
+  }
+  return quatMagSq >= MPU6050_QUAT_MIN && quatMagSq <= MPU6050_QUAT_MAX;
+}
 void tickMPUTilt(Controller_t *controller) {
-  static short sensors;
-  static unsigned char fifoCount;
-  dmp_read_fifo(NULL, NULL, q._l, NULL, &sensors, &fifoCount);
-  if (sensors == INV_WXYZ_QUAT) {
-    q._f.w = q._l[0] >> 23;
-    q._f.x = q._l[1] >> 23;
-    q._f.y = q._l[2] >> 23;
-    q._f.z = q._l[3] >> 23;
+  if (mpuDevice.done) {
+    mpuDevice.done = false;
+    if (mpuReadingPacket) {
+      mpuReadingPacket = false;
+      if (!mpuDevice.success || !readMPUPacket()) {
+        // The FIFO may not line up with packets any more
+        mpu_reset_fifo();
+        mpuPacketsLeft = 0;
+      } else if (!--mpuPacketsLeft) {
+        q._f.w = q._l[0] >> 23;
+        q._f.x = q._l[1] >> 23;
+        q._f.y = q._l[2] >> 23;
+        q._f.z = q._l[3] >> 23;
 
-    quaternionToEuler(&q._f, &mpuTilt, mpuOrientation);
-    mpuTilt = tiltInverted ? -mpuTilt : mpuTilt;
+        quaternionToEuler(&q._f, &mpuTilt, mpuOrientation);
+        mpuTilt = tiltInverted ? -mpuTilt : mpuTilt;
+      }
+    } else if (mpuDevice.success) {
+      uint16_t count = mpuFifoCount[0] << 8 | mpuFifoCount[1];
+      if (count >= MPU6050_FIFO_LIMIT || count % MPU6050_PACKET_LENGTH) {
+        // This is rare, so it is fine for it to block
+        mpu_reset_fifo();
+      } else {
+        mpuPacketsLeft = count / MPU6050_PACKET_LENGTH;
+      }
+    }
+  }
+  if (mpuPacketsLeft) {
+    if (!mpuReadingPacket) {
+      mpuReadingPacket = twi_scheduleRead(&mpuDevice, MPU6050_FIFO_PTR,
+                                          sizeof(mpuPacket), mpuPacket);
+    }
+  } else if (!mpuReadingPacket && !mpuDevice.pending && mpuSampleDue()) {
+    twi_scheduleRead(&mpuDevice, MPU6050_FIFO_COUNT_PTR, sizeof(mpuFifoCount),
+                     mpuFifoCount);
   }
   analogueData[XBOX_TILT] = mpuTilt;
-  int32_t val = mpuTilt;
-  val -= scale.offset;
-  val *= scale.multiplier;
-  val /= 1024;
-  val += INT16_MIN;
-  if (val > INT16_MAX) val = INT16_MAX;
-  if (val < INT16_MIN) val = INT16_MIN;
-  // if (val < scale.deadzone) { val = INT16_MIN; }
-  controller->r_y = val;
+  controller->r_y = lookupAxis(XBOX_TILT, filterAxis(XBOX_TILT, mpuTilt));
 }
 void tickDigitalTilt(Controller_t *controller) {
   controller->r_y = (!digitalRead(tiltPin)) * 32767;
@@ -79,37 +141,105 @@ void initGuitar(Configuration_t *config) {
   if (!typeIsGuitar) return;
   if (config->main.tiltType == MPU_6050) {
     mpuOrientation = config->axis.mpu6050Orientation;
-    initMPU6050(30);
+    uint8_t rate = config->mpu6050.rate;
+    if (!rate) { rate = MPU_6050_RATE; }
+    if (rate > MPU6050_MAX_RATE) { rate = MPU6050_MAX_RATE; }
+    initMPU6050(rate);
+    mpuReadingPacket = false;
+    mpuPacketsLeft = 0;
+    // Polling only needs to keep up with the DMP
+    uint32_t interval = 1000000UL / rate;
+    if (interval > UINT16_MAX) { interval = UINT16_MAX; }
+    twi_addDevice(&mpuDevice, MPU6050_ADDR, 0, MPU6050_PRIORITY, interval);
+    uint8_t intPin = config->mpu6050.intPin;
+    mpuUseInterrupt = false;
+    if (intPin != INVALID_PIN) {
+      // A pulse is too short to be sure of catching from a pin change
+      // interrupt, so INT is latched until the next read
+      mpu_set_int_latched(1);
+      pinMode(intPin, INPUT);
+      detachInterrupt(intPin);
+      mpuUseInterrupt = attachInterrupt(intPin, mpuInterrupt, RISING);
+      // INT may already be high, so the first sample doesn't wait for it
+      mpuDataReady = true;
+    }
     tick = tickMPUTilt;
   } else if (config->main.tiltType == DIGITAL) {
     tiltPin = config->pins.r_y.pin;
     pinMode(tiltPin, INPUT_PULLUP);
     tick = tickDigitalTilt;
   }
-  scale = config->axisScale.r_y;
   tiltInverted = config->pins.r_y.inverted;
 }
-void tickGuitar(Controller_t *controller) {
-  if (!typeIsGuitar) return;
-  Guitar_t *g = (Guitar_t *)controller;
-  int32_t whammy = g->whammy;
-  if (whammy > 0xFFFF) { whammy = 0xFFFF; }
-  if (whammy < 0) { whammy = 0; }
-  g->whammy = whammy;
-  if (tick == NULL) return;
-  tick(controller);
-}
 
-// TODO: this is all we need for grabbing data from a gh5 neck. We should test
-// this, do we actually need to run it at 100khz, or does our i2c implementation
-// work better somehow
+// The OK flag, buttons and both sliders are next to each other, so they are
+// read in one go, in the background. Each tick uses the data read since the
+// tick before.
+#define GH5NECK_CLOCK 400000
+#define GH5NECK_BURST_LENGTH (GH5NECK_SLIDER_OLD_PTR - GH5NECK_OK_PTR + 1)
+// The neck shares the bus with a Wii extension, so it goes after it
+#define GH5NECK_PRIORITY 1
+#define GH5NECK_INTERVAL_US 1000
+bool neckEnabled;
+TwiDevice_t neckDevice;
+uint8_t neckData[GH5NECK_BURST_LENGTH];
+uint16_t neckButtons;
+int16_t neckSlider;
+// The fret that each bit of the button register is
+const uint8_t neckFrets[5] = {XBOX_A, XBOX_B, XBOX_Y, XBOX_X, XBOX_LB};
+// The slider values an Xbox 360 guitar reports, from green to orange, with
+// each pair of adjacent frets in between. The new slider register uses these
+// values directly.
+const uint8_t neckSliderValues[9] = {0x95, 0xB0, 0xCD, 0xE6, 0x1A,
+                                     0x2F, 0x49, 0x66, 0x7F};
+// The old slider register uses the World Tour touch bar values. This is the
+// highest value for each position in neckSliderValues.
+const uint8_t neckOldSliderLimits[9] = {0x05, 0x08, 0x0B, 0x0E, 0x13,
+                                        0x16, 0x19, 0x1C, 0x1F};
+#define GH5NECK_OLD_SLIDER_NONE 0x0F
+uint8_t decodeOldSlider(uint8_t value) {
+  value &= 0x1F;
+  if (value == GH5NECK_OLD_SLIDER_NONE) return 0;
+  uint8_t i = 0;
+  while (value > neckOldSliderLimits[i]) { i++; }
+  return neckSliderValues[i];
+}
+// Picks up a finished read and returns the frets it saw. This is called while
+// the buttons are read, so that the frets are debounced along with them.
+uint16_t readGH5NeckButtons(void) {
+  if (!neckDevice.done) return neckButtons;
+  neckDevice.done = false;
+  neckButtons = 0;
+  neckSlider = 0;
+  // A failed read or a neck that isn't ready leaves nothing held
+  if (!neckDevice.success || !neckData[0]) return 0;
+  uint8_t frets = neckData[GH5NECK_BUTTONS_PTR - GH5NECK_OK_PTR];
+  for (uint8_t i = 0; i < sizeof(neckFrets); i++) {
+    if (bit_check(frets, i)) { bit_set(neckButtons, neckFrets[i]); }
+  }
+  uint8_t slider = neckData[GH5NECK_SLIDER_NEW_PTR - GH5NECK_OK_PTR];
+  if (!slider) {
+    // Older necks only fill in the old register
+    slider = decodeOldSlider(neckData[GH5NECK_SLIDER_OLD_PTR - GH5NECK_OK_PTR]);
+  }
+  neckSlider = (int8_t)slider << 8;
+  return neckButtons;
+}
 void tickGH5Neck(Controller_t *controller) {
-  uint8_t ok;
-  twi_readFromPointer(GH5NECK_ADDR, GH5NECK_OK_PTR, 1, &ok);
-  if (ok) {
-    uint8_t buttons;
-    twi_readFromPointer(GH5NECK_ADDR, GH5NECK_BUTTONS_PTR, 1, &buttons);
-    uint8_t slider;
-    twi_readFromPointer(GH5NECK_ADDR, GH5NECK_SLIDER_NEW_PTR, 1, &slider);
+  if (twi_startSample(&neckDevice)) {
+    twi_scheduleRead(&neckDevice, GH5NECK_OK_PTR, sizeof(neckData), neckData);
   }
-}
\ No newline at end of file
+  controller->l_y = neckSlider;
+}
+void initGH5Neck(Configuration_t *config) {
+  neckDevice.done = false;
+  neckButtons = 0;
+  neckSlider = 0;
+  // Frets that aren't wired to a pin still need to be debounced
+  for (uint8_t i = 0; i < sizeof(neckFrets); i++) {
+    debounceAddButton(neckFrets[i], config->debounce.buttons);
+  }
+  twi_setFrequency(GH5NECK_CLOCK);
+  twi_addDevice(&neckDevice, GH5NECK_ADDR, 0, GH5NECK_PRIORITY,
+                GH5NECK_INTERVAL_US);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "config/defines.h"
+#include "controller/controller.h"
+#include "pins/pins.h"
+#include "util/util.h"
+#include <stdint.h>
+// A matrix of buttons, with each row driven low in turn and every column read
+// together with a port scan. Only one row is read each tick, and the next row
+// is driven straight after, so a row has a whole tick to settle before it is
+// read and the scan never has to wait.
+// Without diodes, three buttons pressed on the corners of a rectangle make the
+// fourth corner look pressed too. Rows that share more than one pressed column
+// can't be trusted, so they keep their last good state until that clears up.
+// With diodes this can't happen, and idle rows can be driven high instead of
+// left floating, which lets the columns recover faster.
+// Rows that aren't set are skipped over
+uint8_t matrixRows[MATRIX_MAX_ROWS];
+bool matrixEnabled;
+uint8_t matrixCurrentRow;
+bool matrixDiodes;
+// The raw columns seen on each row, and the last state that wasn't ghosted
+uint8_t matrixRaw[MATRIX_MAX_ROWS];
+uint8_t matrixState[MATRIX_MAX_ROWS];
+// For each button, the key it is wired to, as row * MATRIX_MAX_COLUMNS +
+// column
+uint8_t matrixBindings[XBOX_BTN_COUNT];
+void releaseMatrixRow(uint8_t row) {
+  if (matrixDiodes) {
+    digitalWrite(matrixRows[row], 1);
+  } else {
+    pinMode(matrixRows[row], INPUT);
+  }
+}
+void driveMatrixRow(uint8_t row) {
+  pinMode(matrixRows[row], OUTPUT);
+  digitalWrite(matrixRows[row], 0);
+}
+void initMatrix(Configuration_t *config) {
+  memcpy(matrixRows, config->matrix.rows, sizeof(matrixRows));
+  memcpy(matrixBindings, config->matrix.bindings, sizeof(matrixBindings));
+  memset(matrixRaw, 0, sizeof(matrixRaw));
+  memset(matrixState, 0, sizeof(matrixState));
+  matrixDiodes = config->matrix.diodes;
+  matrixEnabled = false;
+  for (uint8_t i = 0; i < MATRIX_MAX_ROWS; i++) {
+    if (matrixRows[i] == INVALID_PIN) continue;
+    if (!matrixEnabled) { matrixCurrentRow = i; }
+    matrixEnabled = true;
+    if (matrixDiodes) { pinMode(matrixRows[i], OUTPUT); }
+    releaseMatrixRow(i);
+  }
+  // Columns are read with a port scan, using the column as the offset
+  Pin_t columns[MATRIX_MAX_COLUMNS];
+  uint8_t columnCount = 0;
+  for (uint8_t i = 0; i < MATRIX_MAX_COLUMNS; i++) {
+    uint8_t pin = config->matrix.columns[i];
+    if (pin == INVALID_PIN) continue;
+    pinMode(pin, INPUT_PULLUP);
+    columns[columnCount++] = setUpDigital(config, pin, i, false, false);
+  }
+  setUpPortScan(columns, columnCount);
+  if (matrixEnabled) { driveMatrixRow(matrixCurrentRow); }
+}
+uint16_t readMatrixButtons(void) {
+  if (!matrixEnabled) return 0;
+  uint8_t current = matrixCurrentRow;
+  matrixRaw[current] = readPortScan();
+  releaseMatrixRow(current);
+  do {
+    if (++current == MATRIX_MAX_ROWS) { current = 0; }
+  } while (matrixRows[current] == INVALID_PIN);
+  matrixCurrentRow = current;
+  driveMatrixRow(current);
+  for (uint8_t i = 0; i < MATRIX_MAX_ROWS; i++) {
+    bool ghosted = false;
+    if (!matrixDiodes) {
+      for (uint8_t j = 0; j < MATRIX_MAX_ROWS && !ghosted; j++) {
+        uint8_t shared = matrixRaw[i] & matrixRaw[j];
+        // More than one bit set
+        ghosted = i != j && (shared & (shared - 1));
+      }
+    }
+    if (!ghosted) { matrixState[i] = matrixRaw[i]; }
+  }
+  uint16_t ret = 0;
+  for (uint8_t i = 0; i < XBOX_BTN_COUNT; i++) {
+    uint8_t key = matrixBindings[i];
+    if (key >= MATRIX_MAX_ROWS * MATRIX_MAX_COLUMNS) continue;
+    if (bit_check(matrixState[key / MATRIX_MAX_COLUMNS],
+                  key % MATRIX_MAX_COLUMNS)) {
+      bit_set(ret, i);
+    }
+  }
+  return ret;
+}
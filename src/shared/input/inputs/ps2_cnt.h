@@ -1,7 +1,9 @@
 #pragma once
 #include "controller/controller.h"
 #include "eeprom/eeprom.h"
+#include "input/input_handler.h"
 #include "output/descriptors.h"
+#include "output/reports.h"
 #include "pins/pins.h"
 #include "pins_arduino.h"
 #include "spi/spi.h"
@@ -13,24 +15,30 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#ifndef __AVR__
-#endif
 // TODO: this seems like a much nicer implementation to copy
 // https://github.com/RandomInsano/pscontroller-rs/blob/master/src/lib.rs
 /** \brief Command Inter-Byte Delay (us)
  *
  * Commands are several bytes long. This is the time to wait between two
- * consecutive bytes.
+ * consecutive bytes, if the \a Acknowledge line isn't wired up.
  *
- * This should actually be done by watching the \a Acknowledge line, but we are
- * ignoring it at the moment.
+ * \sa ACK_TIMEOUT
  */
 #define INTER_CMD_BYTE_DELAY 15
 
+/** \brief Acknowledge timeout (us)
+ *
+ * The controller pulls \a Acknowledge low for a couple of microseconds once it
+ * is ready for the next byte, which is usually much sooner than
+ * INTER_CMD_BYTE_DELAY. This is the longest to wait for that, which is the
+ * limit given for the original PlayStation.
+ */
+#define ACK_TIMEOUT 100
+
 /** \brief Command timeout (ms)
  *
- * Commands are sent to the controller repeatedly, until they succeed or time
- * out. This is the length of that timeout.
+ * Config commands are sent to the controller once a tick, until they succeed
+ * or time out. This is the length of that timeout.
  *
  * \sa COMMAND_RETRY_INTERVAL
  */
@@ -38,8 +46,8 @@
 
 /** \brief Command Retry Interval (ms)
  *
- * When sending a command to the controller, if it does not succeed, it is
- * retried after this amount of time.
+ * If nothing replies while connecting, the next attempt is made after this
+ * amount of time.
  */
 #define COMMAND_RETRY_INTERVAL 10
 
@@ -98,6 +106,7 @@ enum PsxAnalogButton {
 enum GHAnalogButton { GH_WHAMMY = PSAB_L1 };
 
 void tickPS2CtrlInput(Controller_t *controller);
+bool readPS2Button(Pin_t pin);
 // Commands for communicating with a PSX controller
 static const uint8_t commandEnterConfig[] = {0x01, 0x43, 0x00, 0x01};
 static const uint8_t commandExitConfig[] = {0x01, 0x43, 0x00, 0x00};
@@ -108,7 +117,26 @@ static const uint8_t commandSetMode[] = {0x01, 0x44, 0x00, /* enabled */ 0x01,
 static const uint8_t commandSetPressures[] = {0x01, 0x4F, 0x00, 0xFF, 0xFF,
                                               0x03, 0x00, 0x00, 0x00};
 
-static const uint8_t commandPollInput[] = {0x01, 0x42, 0x00};
+// Maps the first byte after a poll to the small motor, and the second to the
+// large motor
+static const uint8_t commandEnableRumble[] = {0x01, 0x4D, 0x00, 0x00, 0x01,
+                                              0xFF, 0xFF, 0xFF, 0xFF};
+// On the multi adaptor, polls ask a multitap for all four ports at once. A
+// controller plugged in directly ignores this, and replies as usual.
+#ifdef MULTI_ADAPTOR
+#  define POLL_MULTITAP 0x01
+#else
+#  define POLL_MULTITAP 0x00
+#endif
+// Polls also set the motors, so rumble costs no extra time on the bus. The
+// small motor is either on or off, the large motor has a speed.
+uint8_t commandPollInput[] = {0x01, 0x42, POLL_MULTITAP, /* small */ 0x00,
+                              /* large */ 0x00};
+#define RUMBLE_SMALL_THRESHOLD 0x80
+void updatePollRumble(void) {
+  commandPollInput[3] = rumbleSmall >= RUMBLE_SMALL_THRESHOLD ? 0xFF : 0x00;
+  commandPollInput[4] = rumbleLarge;
+}
 /** \brief neGcon I/II-button press threshold
  *
  * The neGcon does not report digital button press data for its analog buttons,
@@ -259,16 +287,39 @@ static inline bool isConfigReply(const uint8_t *status) {
   return (status[1] & 0xF0) == 0xF0;
 }
 
+static inline bool isMultitapReply(const uint8_t *status) {
+  return status[1] == 0x80;
+}
+
+// A multitap gives every port 8 bytes, whatever is plugged into it
+#define MULTITAP_PORTS 4
+#define MULTITAP_PORT_LENGTH 8
+
+// The length of the whole reply, including the 3 byte header
+static inline uint8_t replyLength(const uint8_t *status) {
+  if (isMultitapReply(status)) {
+    return 3 + MULTITAP_PORTS * MULTITAP_PORT_LENGTH;
+  }
+  return (status[1] & 0x0F) * 2 + 3;
+}
+
 /** \brief Size of internal communication buffer
  *
- * This can be sized after the longest command reply (which is 21 bytes for
- * 01 42 when in DualShock 2 mode), but we're better safe than sorry.
+ * This can be sized after the longest command reply (which is 35 bytes for
+ * 01 42 01 to a multitap), but we're better safe than sorry.
  */
-#define BUFFER_SIZE 32
+#define BUFFER_SIZE 40
 
+// Until a full reply has been read, it isn't known if Acknowledge is wired up,
+// so it is watched for the same time as the fixed delay
+enum PsxAckState { ACK_UNKNOWN, ACK_WIRED, ACK_MISSING };
+uint8_t ackState = ACK_UNKNOWN;
+#ifdef __AVR__
 Pin_t attention;
 Pin_t command;
 Pin_t clock;
+Pin_t acknowledge;
+bool ackSeen;
 void noAttention(void) {
   spi_high();
   digitalWritePin(attention, true);
@@ -279,11 +330,46 @@ void signalAttention(void) {
   spi_low();
   _delay_us(ATTN_DELAY);
 }
-void shiftDataInOut(const uint8_t *out, uint8_t *in, const uint8_t len) {
+// Returns true if the controller acknowledged the last byte within timeout
+// microseconds. The pulse only lasts a couple of microseconds, so the pin is
+// polled in a tight loop, and timer 0 (4us a tick at 16MHz) keeps the time.
+bool waitForAck(uint8_t timeout) {
+  volatile uint8_t *port = acknowledge.port;
+  uint8_t mask = acknowledge.mask;
+  // Round up, and add one for the partial tick that we start in
+  uint8_t ticks = (timeout * clockCyclesPerMicrosecond() + 63) / 64 + 1;
+  uint8_t start = TCNT0;
+  // Acknowledge is active low
+  while (*port & mask) {
+    if ((uint8_t)(TCNT0 - start) >= ticks) return false;
+  }
+  // Let the pulse finish, so that it isn't mistaken for the next one
+  while (!(*port & mask)) {
+    if ((uint8_t)(TCNT0 - start) >= ticks) break;
+  }
+  return true;
+}
+void waitForNextByte(void) {
+  switch (ackState) {
+  case ACK_WIRED:
+    waitForAck(ACK_TIMEOUT);
+    break;
+  case ACK_MISSING:
+    _delay_us(INTER_CMD_BYTE_DELAY); // Very important!
+    break;
+  case ACK_UNKNOWN:
+    ackSeen |= waitForAck(INTER_CMD_BYTE_DELAY);
+    break;
+  }
+}
+// The controller doesn't acknowledge the last byte of a reply, so there is
+// nothing to wait for after it if final is set
+void shiftDataInOut(const uint8_t *out, uint8_t *in, const uint8_t len,
+                    bool final) {
   for (uint8_t i = 0; i < len; ++i) {
     uint8_t resp = spi_transfer(out != NULL ? out[i] : 0x5A);
     if (in != NULL) { in[i] = resp; }
-    _delay_us(INTER_CMD_BYTE_DELAY); // Very important!
+    if (!final || i != len - 1) { waitForNextByte(); }
   }
 }
 uint8_t *autoShiftData(const uint8_t *out, const uint8_t len) {
@@ -294,174 +380,358 @@ uint8_t *autoShiftData(const uint8_t *out, const uint8_t len) {
 
   if (len >= 3 && len <= BUFFER_SIZE) {
     // All commands have at least 3 bytes, so shift out those first
-    shiftDataInOut(out, inputBuffer, 3);
+    ackSeen = false;
+    shiftDataInOut(out, inputBuffer, 3, false);
     if (isValidReply(inputBuffer)) {
       // Reply is good, get full length
 
-      uint8_t replyLen = (inputBuffer[1] & 0x0F) * 2;
+      uint8_t left = replyLength(inputBuffer) - len;
 
       // Shift out rest of command
-      if (len > 3) { shiftDataInOut(out + 3, inputBuffer + 3, len - 3); }
+      if (len > 3) {
+        shiftDataInOut(out + 3, inputBuffer + 3, len - 3, left == 0);
+      }
 
-      uint8_t left = replyLen - len + 3;
       if (left == 0) {
         // The whole reply was gathered
         ret = inputBuffer;
       } else if (len + left <= BUFFER_SIZE) {
         // Part of reply is still missing and we have space for it
-        shiftDataInOut(NULL, inputBuffer + len, left);
+        shiftDataInOut(NULL, inputBuffer + len, left, true);
         ret = inputBuffer;
       } else {
         // Reply incomplete but not enough space provided
       }
+      if (ret && ackState == ACK_UNKNOWN) {
+        ackState = ackSeen ? ACK_WIRED : ACK_MISSING;
+      }
     }
   }
   noAttention();
   return ret;
 }
-bool sendCommand(const uint8_t *buf, uint8_t len) {
-  bool ret = false;
+#else
+// The PIO sends the whole frame at once, so it has to be long enough for the
+// reply before it starts. This is the length of the last reply, starting from
+// a DualShock 2 with pressures, which is the longest.
+#  define PSX_POLL_LENGTH 21
+uint8_t psxReplyLength = PSX_POLL_LENGTH;
+uint8_t psxReply[PSX_MAX_FRAME];
+uint8_t psxFrameLength;
+// Set if the last frame was too short for the reply
+bool psxShort;
+// Returns the reply to the frame that just finished, or NULL if there isn't a
+// complete one
+uint8_t *finishFrame(void) {
+  psxShort = false;
+  if (!psx_ok() || !isValidReply(psxReply)) return NULL;
+  uint8_t length = replyLength(psxReply);
+  if (length > PSX_MAX_FRAME) return NULL;
+  psxReplyLength = length;
+  if (length > psxFrameLength) {
+    psxShort = true;
+    return NULL;
+  }
+  if (ackState == ACK_UNKNOWN) {
+    ackState = psx_ackSeen() ? ACK_WIRED : ACK_MISSING;
+    if (ackState == ACK_WIRED) { psx_setAckTimeout(ACK_TIMEOUT); }
+  }
+  return psxReply;
+}
+bool startFrame(const uint8_t *out, const uint8_t len) {
+  psxFrameLength = len > psxReplyLength ? len : psxReplyLength;
+  return psx_start(out, len, psxReply, psxFrameLength);
+}
+#endif
+uint16_t buttonWord;
+void parsePoll(Controller_t *controller, uint8_t *in) {
+  // We surely have buttons
+  buttonWord = ~(((uint16_t)in[4] << 8) | in[3]);
+
+  if (isFlightStickReply(in)) { ps2CtrlType = PSX_ANALOG; }
+  if (isNegconReply(in)) {
+    ps2CtrlType = PSX_NEGCON;
+    controller->l_x = (in[5] - 128) << 8;
+    // These buttons are only analog, map them to digital
+    bit_write(in[6] > NEGCON_I_II_BUTTON_THRESHOLD, controller->buttons,
+              XBOX_X);
+    bit_write(in[7] > NEGCON_I_II_BUTTON_THRESHOLD, controller->buttons,
+              XBOX_Y);
+    bit_write(in[8] > NEGCON_L_BUTTON_THRESHOLD, controller->buttons,
+              XBOX_LB);
+  }
+  if (isJogconReply(in)) {
+    ps2CtrlType = PSX_JOGCON;
+    /* Map the wheel X axis of left analog, half a rotation
+     * per direction: byte 5 has the wheel position, it is
+     * 0 at startup, then we have 0xFF down to 0x80 for
+     * left/CCW, and 0x01 up to 0x80 for right/CW
+     *
+     * byte 6 is the number of full CW rotations
+     * byte 7 is 0 if wheel is still, 1 if it is rotating CW
+     *        and 2 if rotation CCW
+     * byte 8 seems to stay at 0
+     *
+     * We'll want to cap the movement halfway in each
+     * direction, for ease of use/implementation.
+     */
+    controller->l_x = in[5];
+    if (in[6] < 0x80) {
+      // CW up to half
+      controller->l_x = in[5] < 0x80 ? in[5] : (0x80 - 1);
+    } else {
+      // CCW down to half
+      controller->l_x = in[5] > 0x80 ? in[5] : (0x80 + 1);
+    }
+
+    // Bring to the usual 0-255 range
+    controller->l_x += 0x80;
+  }
+  if (isMouseReply(in)) {
+    ps2CtrlType = PSX_MOUSE;
+    controller->l_x = (in[5] - 128) << 8;
+    controller->l_y = -(in[6] - 127) << 8;
+  }
+  if (isDualShockReply(in) || isFlightStickReply(in)) {
+    controller->r_x = (in[5] - 128) << 8;
+    controller->r_y = -(in[6] - 127) << 8;
+    controller->l_x = (in[7] - 128) << 8;
+    controller->l_y = -(in[8] - 127) << 8;
+    if (typeIsGuitar) {
+      ps2CtrlType = PSX_GUITAR_HERO_CONTROLLER;
+      controller->l_x = 0;
+      controller->l_y = 0;
+      controller->r_x = (in[8] - 128) << 8;
+      controller->r_y = (!!bit_check(buttonWord, GH_STAR_POWER)) * 32767;
+    }
+    if (isDualShock2Reply(in)) {
+      controller->lt = in[PSAB_L2 + 9];
+      controller->rt = in[PSAB_R2 + 9];
+      ps2CtrlType = PSX_DUALSHOCK_2_CONTROLLER;
+    } else if (!isFlightStickReply(in)) {
+      ps2CtrlType = PSX_DUALSHOCK_1_CONTROLLER;
+    }
+  }
+}
 
-  unsigned long start = millis();
-  uint8_t cnt = 0;
-  do {
-    uint8_t *in = autoShiftData(buf, len);
+/** \brief Missed polls
+ *
+ * A controller is only treated as unplugged once this many polls in a row have
+ * failed, so that a single bad reply doesn't start the connection over.
+ */
+#define MAX_MISSED_POLLS 3
 
+/** \brief Connect replies
+ *
+ * Some disposable readings to let the controller know we are here, before
+ * deciding what to do with it.
+ */
+#define CONNECT_REPLIES 3
+
+// Connecting is spread across ticks, with at most one frame sent each tick, so
+// that a missing or glitching controller never holds up the main loop
+enum PsxState { PS2_CONNECTING, PS2_CONFIGURING, PS2_POLLING };
+static const uint8_t *const configCommands[] = {
+    commandEnterConfig, commandSetMode, commandEnableRumble,
+#ifndef MULTI_ADAPTOR
+    commandSetPressures,
+#endif
+    commandExitConfig};
+// A multitap only passes on the first six bytes from each port, so pressures
+// are left off there. Config frames go out without a port, so a multitap only
+// hands them to port A, and controllers on ports B-D are polled in whatever
+// mode they powered up in.
+static const uint8_t configLengths[] = {
+    sizeof(commandEnterConfig), sizeof(commandSetMode),
+    sizeof(commandEnableRumble),
+#ifndef MULTI_ADAPTOR
+    sizeof(commandSetPressures),
+#endif
+    sizeof(commandExitConfig)};
+#define CONFIG_EXIT_STEP (sizeof(configLengths) - 1)
+uint8_t ps2State;
+uint8_t configStep;
+// Valid replies seen in the current state or config step, and when it started
+uint8_t stepReplies;
+unsigned long stepMillis;
+uint8_t missedPolls;
+// The reply type of the last controller that was polled. A DualShock 2 that
+// comes back still in the mode that config put it in doesn't need to be
+// configured again.
+uint8_t lastReplyType = 0xFF;
+#ifndef __AVR__
+bool psxStarted;
+#endif
+void resetAck(void) {
+  ackState = ACK_UNKNOWN;
+#ifndef __AVR__
+  psx_setAckTimeout(INTER_CMD_BYTE_DELAY);
+#endif
+}
+void setPS2State(uint8_t state) {
+  ps2State = state;
+  stepReplies = 0;
+  stepMillis = millis();
+  missedPolls = 0;
+}
+void startConfigStep(uint8_t step) {
+  configStep = step;
+  setPS2State(PS2_CONFIGURING);
+}
+void disconnectPS2(void) {
+  ps2CtrlType = PSX_NO_DEVICE;
+  setPS2State(PS2_CONNECTING);
+  // The next controller may be wired up differently
+  resetAck();
+}
+// Nothing answered the last attempt to connect, so wait a bit before the next
+bool waitingToConnect(void) {
+  return ps2State == PS2_CONNECTING && !stepReplies &&
+         millis() - stepMillis < COMMAND_RETRY_INTERVAL;
+}
+void nextFrame(const uint8_t **out, uint8_t *len) {
+  if (ps2State == PS2_CONFIGURING) {
+    *out = configCommands[configStep];
+    *len = configLengths[configStep];
+    return;
+  }
+  updatePollRumble();
+  *out = commandPollInput;
+  *len = sizeof(commandPollInput);
+}
+#ifdef MULTI_ADAPTOR
+// Each port of a multitap is the id, 5A, and then the first six bytes of that
+// controller's own reply, so each one is parsed as a reply of its own. The
+// first port goes last, so buttonWord and ps2CtrlType are left set for it.
+void parseMultitap(Controller_t *controller, uint8_t *in) {
+  for (uint8_t port = MULTITAP_PORTS; port--;) {
+    uint8_t *reply = in + 2 + port * MULTITAP_PORT_LENGTH;
+    Controller_t *target = port ? &extraControllers[port - 1] : controller;
+    if (port) { memset(target, 0, sizeof(Controller_t)); }
+    if (!isValidReply(reply)) {
+      buttonWord = 0;
+      continue;
+    }
+    // Pressures don't fit, so they can't be read
+    if (isDualShock2Reply(reply)) { reply[1] = 0x73; }
+    parsePoll(target, reply);
+    if (!port) continue;
+    // The other players don't have pins, so their buttons are mapped here
+    for (uint8_t i = 0; i < XBOX_BTN_COUNT; i++) {
+      Pin_t pin = {.offset = i};
+      if (readPS2Button(pin)) { bit_set(target->buttons, i); }
+    }
+  }
+}
+#endif
+// Moves the connection along, using the reply to the frame sent for the
+// current state, or NULL if there wasn't a valid one
+void handleReply(Controller_t *controller, uint8_t *in) {
+  switch (ps2State) {
+  case PS2_CONNECTING:
+    if (!in) {
+      setPS2State(PS2_CONNECTING);
+    } else if (++stepReplies >= CONNECT_REPLIES) {
+      // Controllers power up in digital mode, which looks the same as a
+      // digital pad, so only a mode that config sets up shows that the
+      // controller kept it
+      if (in[1] == lastReplyType && isDualShock2Reply(in)) {
+        // The next tick polls it properly
+        setPS2State(PS2_POLLING);
+      } else {
+        startConfigStep(0);
+      }
+    }
+    break;
+  case PS2_CONFIGURING: {
     /* We can't know if we have successfully enabled analog mode until
      * we get out of config mode, so let's just be happy if we get a few
      * consecutive valid replies
      */
-    if (in != NULL) {
-      ++cnt;
-      if (buf == commandEnterConfig) {
-        ret = isConfigReply(in);
-      } else if (buf == commandExitConfig) {
-        ret = !isConfigReply(in);
+    bool done = false;
+    if (in) {
+      ++stepReplies;
+      if (configStep == 0) {
+        done = isConfigReply(in);
+      } else if (configStep == CONFIG_EXIT_STEP) {
+        done = !isConfigReply(in);
       } else {
-        ret = cnt >= 3;
+        done = stepReplies >= 3;
       }
     }
-
-    if (!ret) { _delay_ms(COMMAND_RETRY_INTERVAL); }
-  } while (!ret && millis() - start <= COMMAND_TIMEOUT);
-
-  return ret;
-}
-uint16_t buttonWord;
-bool read(Controller_t *controller) {
-  bool ret = false;
-  uint8_t *in = autoShiftData(commandPollInput, sizeof(commandPollInput));
-
-  if (in != NULL) {
-    if (isConfigReply(in)) {
+    if (done || millis() - stepMillis > COMMAND_TIMEOUT) {
+      if (!stepReplies) {
+        disconnectPS2();
+      } else if (configStep == CONFIG_EXIT_STEP ||
+                 (!done && configStep == 0)) {
+        // Dualshock one controllers don't have config mode, so they are just
+        // polled as they are
+        setPS2State(PS2_POLLING);
+      } else {
+        startConfigStep(configStep + 1);
+      }
+    }
+    break;
+  }
+  case PS2_POLLING:
+    if (!in) {
+      if (++missedPolls >= MAX_MISSED_POLLS) { disconnectPS2(); }
+    } else if (isConfigReply(in)) {
       // We're stuck in config mode, try to get out
-      sendCommand(commandExitConfig, sizeof(commandExitConfig));
+      startConfigStep(CONFIG_EXIT_STEP);
     } else {
-      // We surely have buttons
-      buttonWord = ~(((uint16_t)in[4] << 8) | in[3]);
-
-      if (isFlightStickReply(in)) { ps2CtrlType = PSX_ANALOG; }
-      if (isNegconReply(in)) {
-        ps2CtrlType = PSX_NEGCON;
-        controller->l_x = (in[5] - 128) << 8;
-        // These buttons are only analog, map them to digital
-        bit_write(in[6] > NEGCON_I_II_BUTTON_THRESHOLD, controller->buttons,
-                  XBOX_X);
-        bit_write(in[7] > NEGCON_I_II_BUTTON_THRESHOLD, controller->buttons,
-                  XBOX_Y);
-        bit_write(in[8] > NEGCON_L_BUTTON_THRESHOLD, controller->buttons,
-                  XBOX_LB);
-      }
-      if (isJogconReply(in)) {
-        ps2CtrlType = PSX_JOGCON;
-        /* Map the wheel X axis of left analog, half a rotation
-         * per direction: byte 5 has the wheel position, it is
-         * 0 at startup, then we have 0xFF down to 0x80 for
-         * left/CCW, and 0x01 up to 0x80 for right/CW
-         *
-         * byte 6 is the number of full CW rotations
-         * byte 7 is 0 if wheel is still, 1 if it is rotating CW
-         *        and 2 if rotation CCW
-         * byte 8 seems to stay at 0
-         *
-         * We'll want to cap the movement halfway in each
-         * direction, for ease of use/implementation.
-         */
-        controller->l_x = in[5];
-        if (in[6] < 0x80) {
-          // CW up to half
-          controller->l_x = in[5] < 0x80 ? in[5] : (0x80 - 1);
-        } else {
-          // CCW down to half
-          controller->l_x = in[5] > 0x80 ? in[5] : (0x80 + 1);
-        }
-
-        // Bring to the usual 0-255 range
-        controller->l_x += 0x80;
-      }
-      if (isMouseReply(in)) {
-        ps2CtrlType = PSX_MOUSE;
-        controller->l_x = (in[5] - 128) << 8;
-        controller->l_y = -(in[6] - 127) << 8;
-      }
-      if (isDualShockReply(in) || isFlightStickReply(in)) {
-        controller->r_x = (in[5] - 128) << 8;
-        controller->r_y = -(in[6] - 127) << 8;
-        controller->l_x = (in[7] - 128) << 8;
-        controller->l_y = -(in[8] - 127) << 8;
-        if (typeIsGuitar) {
-          ps2CtrlType = PSX_GUITAR_HERO_CONTROLLER;
-          controller->l_x = 0;
-          controller->l_y = 0;
-          controller->r_x = (in[8] - 128) << 8;
-          controller->r_y = (!!bit_check(buttonWord, GH_STAR_POWER)) * 32767;
-        }
-        if (isDualShock2Reply(in)) {
-          controller->lt = in[PSAB_L2 + 9];
-          controller->rt = in[PSAB_R2 + 9];
-          ps2CtrlType = PSX_DUALSHOCK_2_CONTROLLER;
-        } else if (!isFlightStickReply(in)) {
-          ps2CtrlType = PSX_DUALSHOCK_1_CONTROLLER;
-        }
+      missedPolls = 0;
+#ifdef MULTI_ADAPTOR
+      if (isMultitapReply(in)) {
+        // A reconnect shows the multitap, not the mode of port A, so it always
+        // goes through config again
+        lastReplyType = 0xFF;
+        parseMultitap(controller, in);
+        break;
       }
+#endif
+      lastReplyType = in[1];
+      parsePoll(controller, in);
     }
-    ret = true;
+    break;
   }
-
-  return ret;
-}
-
-bool begin(Controller_t *controller) {
-  // Some disposable readings to let the controller know we are here
-  for (uint8_t i = 0; i < 5; ++i) {
-    read(controller);
-    _delay_ms(1);
-  }
-  return read(controller);
 }
-
 void initPS2CtrlInput(Configuration_t *config) {
+#ifdef __AVR__
   spi_begin(100000, true, true, true);
   attention = setUpDigital(config, PIN_PS2_ATT, 0, false, true);
   pinMode(PIN_PS2_ATT, OUTPUT);
+  // Acknowledge is open collector, and reads as true while it is pulled low
+  acknowledge = setUpDigital(config, PIN_PS2_ACK, 0, false, false);
+  pinMode(PIN_PS2_ACK, INPUT_PULLUP);
   noAttention();
+#else
+  psx_init();
+  psxStarted = false;
+#endif
+  disconnectPS2();
 }
 void tickPS2CtrlInput(Controller_t *controller) {
-  if (ps2CtrlType == PSX_NO_DEVICE) {
-    if (!begin(controller)) { return; }
-    sendCommand(commandEnterConfig, sizeof(commandEnterConfig));
-    if (true) {
-      // Dualshock one controllers don't have config mode
-      // Enable analog sticks
-      sendCommand(commandSetMode, sizeof(commandSetMode));
-      // Enable analog buttons
-      sendCommand(commandSetPressures, sizeof(commandSetPressures));
-      sendCommand(commandExitConfig, sizeof(commandExitConfig));
-    } else {
-      ps2CtrlType = PSX_DUALSHOCK_1_CONTROLLER;
-    }
+  const uint8_t *out;
+  uint8_t len;
+#ifdef __AVR__
+  if (waitingToConnect()) return;
+  nextFrame(&out, &len);
+  handleReply(controller, autoShiftData(out, len));
+#else
+  // Each tick handles the frame started by the tick before, and then starts the
+  // next one, so the controller never holds up a tick
+  if (psx_busy()) return;
+  if (psxStarted) {
+    psxStarted = false;
+    uint8_t *in = finishFrame();
+    // A reply that was cut short just makes the next frame longer
+    if (in || !psxShort) { handleReply(controller, in); }
   }
-  if (!read(controller)) { ps2CtrlType = PSX_NO_DEVICE; }
+  if (waitingToConnect()) return;
+  nextFrame(&out, &len);
+  psxStarted = startFrame(out, len);
+#endif
 }
 
 bool readPS2Button(Pin_t pin) {
@@ -0,0 +1,62 @@
+#pragma once
+#include "config/defines.h"
+#include "controller/controller.h"
+#include "pins/pins.h"
+#include "spi/spi.h"
+#include "util/util.h"
+#include <stdint.h>
+// 74HC165 parallel in, serial out shift registers, read over SPI. The latch
+// pin loads every input into the registers, and then each register is shifted
+// out, starting with the one connected to MISO. Inputs are expected to be
+// pulled up, so a button reads as low when pressed.
+#define SHIFT_REGISTER_MAX 4
+#define SHIFT_REGISTER_CLOCK 4000000
+uint8_t shiftRegisterLatch;
+uint8_t shiftRegisterCount;
+// APA102s on the same bus need their own SPI mode back after each read
+bool shiftRegisterSharedSPI;
+// For each button, the bit in the chain it is wired to. Bit n is input n % 8
+// (A = 0) of the register n / 8 away from MISO.
+uint8_t shiftRegisterBindings[XBOX_BTN_COUNT];
+void initShiftRegister(Configuration_t *config) {
+  shiftRegisterLatch = config->shiftRegister.latchPin;
+  shiftRegisterCount = config->shiftRegister.count;
+  shiftRegisterSharedSPI = config->main.fretLEDMode == APA102;
+  // Without a latch, nothing is ever loaded into the registers
+  if (shiftRegisterLatch == INVALID_PIN) {
+    shiftRegisterCount = 0;
+    return;
+  }
+  if (shiftRegisterCount > SHIFT_REGISTER_MAX) {
+    shiftRegisterCount = SHIFT_REGISTER_MAX;
+  }
+  memcpy(shiftRegisterBindings, config->shiftRegister.bindings,
+         sizeof(shiftRegisterBindings));
+  pinMode(shiftRegisterLatch, OUTPUT);
+  digitalWrite(shiftRegisterLatch, 1);
+}
+uint16_t readShiftRegisterButtons(void) {
+  if (!shiftRegisterCount) return 0;
+  // The registers shift on the rising edge of the clock, so they are read on
+  // the falling edge (mode 2). The first bit is already out once the latch
+  // goes high, and the first edge is a falling one, so it isn't lost.
+  spi_setMode(true, false);
+  // Loading happens while the latch is low, and shifting while it is high
+  digitalWrite(shiftRegisterLatch, 0);
+  digitalWrite(shiftRegisterLatch, 1);
+  uint32_t bits = 0;
+  for (uint8_t i = 0; i < shiftRegisterCount; i++) {
+    bits |= (uint32_t)spi_transfer(0) << (i * 8);
+  }
+  // APA102s read on the rising edge
+  if (shiftRegisterSharedSPI) { spi_setMode(true, true); }
+  bits = ~bits;
+  uint16_t ret = 0;
+  for (uint8_t i = 0; i < XBOX_BTN_COUNT; i++) {
+    uint8_t bit = shiftRegisterBindings[i];
+    if (bit < shiftRegisterCount * 8 && (bits & ((uint32_t)1 << bit))) {
+      bit_set(ret, i);
+    }
+  }
+  return ret;
+}
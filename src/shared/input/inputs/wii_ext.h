@@ -28,6 +28,49 @@ uint16_t buttons;
 uint8_t bytes = 6;
 bool mapNunchukAccelToRightJoy;
 void (*readFunction)(Controller_t *, uint8_t *) = NULL;
+// Extension data is read in the background. Each tick uses the read queued
+// by the tick before, and then queues the next one.
+// Extensions need some time between the pointer being written and the data
+// being read
+#define WII_READ_DELAY_US 180
+// The extension goes first on the bus, and is read at up to 1kHz
+#define WII_PRIORITY 0
+#define WII_INTERVAL_US 1000
+TwiDevice_t wiiDevice;
+uint8_t wiiData[8];
+uint8_t wiiProbeData[8];
+enum WiiState {
+  WII_CONNECT,
+  WII_DISABLE_ENCRYPTION,
+  WII_IDENTIFY,
+  WII_CONFIGURE,
+  WII_PROBE,
+  WII_RUNNING,
+  WII_UNSUPPORTED
+};
+uint8_t wiiState = WII_CONNECT;
+#define WII_BACKOFF_MIN_MS 8
+#define WII_BACKOFF_MAX_MS 1024
+uint16_t wiiBackoff = WII_BACKOFF_MIN_MS;
+unsigned long wiiRetryMillis;
+// Each probe is two reads
+#define WII_HIGH_RES_PROBES 8
+uint8_t wiiProbes;
+// An extension that was identified but isn't supported. It stays reported as
+// WII_NO_EXTENSION, and only its ID is read now and then, so that a different
+// extension is still picked up.
+uint16_t wiiUnsupportedID;
+#define WII_UNSUPPORTED_CHECK_MS WII_BACKOFF_MAX_MS
+void wiiQueueRead(uint8_t pointer, uint8_t length, uint8_t *data) {
+  twi_scheduleRead(&wiiDevice, pointer, length, data);
+}
+void wiiRetry(void) {
+  wiiExtensionID = WII_NOT_INITIALISED;
+  readFunction = NULL;
+  wiiState = WII_CONNECT;
+  wiiRetryMillis = millis() + wiiBackoff;
+  if (wiiBackoff < WII_BACKOFF_MAX_MS) { wiiBackoff <<= 1; }
+}
 
 bool verifyData(const uint8_t *dataIn, uint8_t dataSize) {
   uint8_t orCheck = 0x00;  // Check if data is zeroed (bad connection)
@@ -45,12 +88,6 @@ bool verifyData(const uint8_t *dataIn, uint8_t dataSize) {
   return true;
 }
 
-uint16_t readExtID(void) {
-  uint8_t data[6];
-  twi_readFromPointerSlow(I2C_ADDR, 0xFA, 6, data);
-  if (!verifyData(data, sizeof(data))) { return WII_NOT_INITIALISED; }
-  return data[0] << 8 | data[5];
-}
 void readDrumExt(Controller_t *controller, uint8_t *data) {
   controller->l_x = (data[0] - 0x20) << 10;
   controller->l_y = (data[1] - 0x20) << 10;
@@ -163,99 +200,207 @@ void readDrawsomeExt(Controller_t *controller, uint8_t *data) {
 void readTataconExt(Controller_t *controller, uint8_t *data) {
   buttons = ~(data[4] << 8 | data[5]);
 }
-void initWiiExt(void) {
-  wiiExtensionID = readExtID();
-  if (wiiExtensionID == WII_NOT_INITIALISED) {
-    // Send packets needed to initialise a controller
-    twi_writeSingleToPointer(I2C_ADDR, 0xF0, 0x55);
-    _delay_us(10);
-    twi_writeSingleToPointer(I2C_ADDR, 0xFB, 0x00);
-    _delay_us(10);
-    wiiExtensionID = readExtID();
-    _delay_us(10);
+// Everything needed to talk to each supported extension. Registers in init
+// are written (as pointer, value) once the extension is identified, one each
+// tick.
+#define WII_MAX_INIT 2
+typedef struct {
+  uint16_t id;
+  uint8_t initCount;
+  uint8_t init[WII_MAX_INIT][2];
+  uint8_t bytes;
+  void (*read)(Controller_t *, uint8_t *);
+  // Check if the extension supports the high res classic controller format
+  bool probeHighRes;
+} WiiExtension_t;
+const WiiExtension_t wiiExtensions[] PROGMEM = {
+    {WII_NUNCHUK, 0, {}, 6, readNunchukExt, false},
+    // Enable high-res mode
+    {WII_CLASSIC_CONTROLLER, 1, {{0xFE, 0x03}}, 6, readClassicExt, true},
+    {WII_CLASSIC_CONTROLLER_PRO, 1, {{0xFE, 0x03}}, 6, readClassicExt, true},
+    {WII_THQ_UDRAW_TABLET, 0, {}, 6, readUDrawExt, false},
+    {WII_UBISOFT_DRAWSOME_TABLET,
+     2,
+     {{0xFB, 0x01}, {0xF0, 0x55}},
+     6,
+     readDrawsomeExt,
+     false},
+    {WII_GUITAR_HERO_GUITAR_CONTROLLER, 0, {}, 6, readGuitarExt, false},
+    {WII_GUITAR_HERO_DRUM_CONTROLLER, 0, {}, 6, readDrumExt, false},
+    {WII_DJ_HERO_TURNTABLE, 0, {}, 6, readDJExt, false},
+    {WII_TAIKO_NO_TATSUJIN_CONTROLLER, 0, {}, 6, readTataconExt, false},
+};
+WiiExtension_t wiiExtension;
+uint8_t wiiInitStep;
+// Returns false if the extension isn't supported
+bool findWiiExt(uint16_t id) {
+  for (uint8_t i = 0; i < sizeof(wiiExtensions) / sizeof(*wiiExtensions);
+       i++) {
+    memcpy_P(&wiiExtension, &wiiExtensions[i], sizeof(wiiExtension));
+    if (wiiExtension.id == id) {
+      readFunction = wiiExtension.read;
+      bytes = wiiExtension.bytes;
+      return true;
+    }
   }
-  if (wiiExtensionID == WII_UBISOFT_DRAWSOME_TABLET) {
-    twi_writeSingleToPointer(I2C_ADDR, 0xFB, 0x01);
-    _delay_us(10);
-    twi_writeSingleToPointer(I2C_ADDR, 0xF0, 0x55);
-    _delay_us(10);
+  return false;
+}
+// Some classic controllers support high res mode, some dont. Some require it,
+// some dont. To mitigate this issue, we can check if the high res specific
+// bytes are zeroed. However this isnt enough. If a byte is corrupted during
+// transit than it may be triggered. Reading twice will allow us to confirm
+// that nothing was corrupted. If the reads never agree, fall back to the
+// standard mode.
+void tickWiiProbe(bool success) {
+  if (!success) {
+    wiiRetry();
+    return;
   }
-  if (wiiExtensionID == WII_CLASSIC_CONTROLLER ||
-      wiiExtensionID == WII_CLASSIC_CONTROLLER_PRO) {
-    // Enable high-res mode
-    twi_writeSingleToPointer(I2C_ADDR, 0xFE, 0x03);
-    _delay_us(10);
-    // Some controllers support high res mode, some dont. Some require it, some
-    // dont. To mitigate this issue, we can check if the high res specific bytes
-    // are zeroed. However this isnt enough. If a byte is corrupted during
-    // transit than it may be triggered. Reading twice will allow us to confirm
-    // that nothing was corrupted,
-    uint8_t check[8];
-    uint8_t validate[8];
-    while (true) {
-      twi_readFromPointerSlow(I2C_ADDR, 0, sizeof(check), check);
-      _delay_us(200);
-      twi_readFromPointerSlow(I2C_ADDR, 0, sizeof(validate), validate);
-      if (memcmp(check, validate, sizeof(validate)) == 0) {
-        bool highRes = (check[0x06] || check[0x07]);
-        if (highRes) {
-          readFunction = readClassicExtHighRes;
-          bytes = 8;
-        } else {
-          readFunction = readClassicExt;
-          bytes = 6;
-        }
-        break;
+  // wiiProbes counts the reads queued so far, odd reads go to wiiProbeData
+  // and even reads go to wiiData
+  if (wiiProbes && !(wiiProbes & 1)) {
+    if (memcmp(wiiData, wiiProbeData, sizeof(wiiData)) == 0) {
+      if (wiiData[6] || wiiData[7]) {
+        readFunction = readClassicExtHighRes;
+        bytes = 8;
       }
-      _delay_us(200);
+      wiiState = WII_RUNNING;
+      return;
+    }
+    if (wiiProbes >= WII_HIGH_RES_PROBES * 2) {
+      wiiState = WII_RUNNING;
+      return;
     }
   }
-  switch (wiiExtensionID) {
-  case WII_GUITAR_HERO_GUITAR_CONTROLLER:
-    readFunction = readGuitarExt;
-    break;
-  case WII_CLASSIC_CONTROLLER:
-  case WII_CLASSIC_CONTROLLER_PRO:
-    break;
-  case WII_NUNCHUK:
-    readFunction = readNunchukExt;
-    break;
-  case WII_GUITAR_HERO_DRUM_CONTROLLER:
-    readFunction = readDrumExt;
-    break;
-  case WII_THQ_UDRAW_TABLET:
-    readFunction = readUDrawExt;
-    break;
-  case WII_UBISOFT_DRAWSOME_TABLET:
-    readFunction = readDrawsomeExt;
-    break;
-  case WII_DJ_HERO_TURNTABLE:
-    readFunction = readDJExt;
-    break;
-  case WII_TAIKO_NO_TATSUJIN_CONTROLLER:
-    readFunction = readTataconExt;
-    break;
-  default:
-    wiiExtensionID = WII_NO_EXTENSION;
-    readFunction = NULL;
-  }
+  wiiProbes++;
+  wiiQueueRead(0x00, 8, (wiiProbes & 1) ? wiiProbeData : wiiData);
 }
+// Each tick does at most one step of connecting to an extension, and anything
+// that needs to wait for the extension is done over the following ticks, so
+// reports keep going out while an extension is connecting. Failures back off
+// exponentially, so a missing extension costs almost nothing.
 void tickWiiExtInput(Controller_t *controller) {
-  uint8_t data[8];
-  if (wiiExtensionID == WII_NOT_INITIALISED ||
-      wiiExtensionID == WII_NO_EXTENSION ||
-      (twi_readFromPointerSlow(I2C_ADDR, 0x00, bytes, data) &&
-       !verifyData(data, bytes))) {
-    initWiiExt();
+  if (wiiDevice.pending) return;
+  bool read = wiiDevice.done;
+  bool success = read && wiiDevice.success;
+  wiiDevice.done = false;
+  switch (wiiState) {
+  case WII_CONNECT:
+    if ((long)(millis() - wiiRetryMillis) < 0) return;
+    // Send packets needed to initialise a controller, one each tick
+    if (!twi_writeSingleToPointer(I2C_ADDR, 0xF0, 0x55)) {
+      wiiRetry();
+      return;
+    }
+    wiiState = WII_DISABLE_ENCRYPTION;
+    return;
+  case WII_DISABLE_ENCRYPTION:
+    if (!twi_writeSingleToPointer(I2C_ADDR, 0xFB, 0x00)) {
+      wiiRetry();
+      return;
+    }
+    wiiState = WII_IDENTIFY;
+    wiiQueueRead(0xFA, 6, wiiData);
+    return;
+  case WII_IDENTIFY:
+    if (!success || !verifyData(wiiData, 6)) {
+      wiiRetry();
+      return;
+    }
+    wiiExtensionID = wiiData[0] << 8 | wiiData[5];
+    if (!findWiiExt(wiiExtensionID)) {
+      wiiUnsupportedID = wiiExtensionID;
+      wiiExtensionID = WII_NO_EXTENSION;
+      wiiState = WII_UNSUPPORTED;
+      wiiRetryMillis = millis() + WII_UNSUPPORTED_CHECK_MS;
+      return;
+    }
+    wiiInitStep = 0;
+    wiiState = WII_CONFIGURE;
+    return;
+  case WII_CONFIGURE:
+    if (wiiInitStep < wiiExtension.initCount) {
+      uint8_t *init = wiiExtension.init[wiiInitStep++];
+      if (!twi_writeSingleToPointer(I2C_ADDR, init[0], init[1])) {
+        wiiRetry();
+      }
+      return;
+    }
+    if (wiiExtension.probeHighRes) {
+      wiiProbes = 0;
+      wiiState = WII_PROBE;
+      tickWiiProbe(true);
+    } else {
+      wiiState = WII_RUNNING;
+    }
+    return;
+  case WII_PROBE:
+    tickWiiProbe(success);
+    return;
+  case WII_RUNNING:
+    if (read) {
+      if (!success || !verifyData(wiiData, bytes)) {
+        wiiRetry();
+        return;
+      }
+      wiiBackoff = WII_BACKOFF_MIN_MS;
+      if (readFunction) readFunction(controller, wiiData);
+    }
+    if (twi_startSample(&wiiDevice)) { wiiQueueRead(0x00, bytes, wiiData); }
+    return;
+  case WII_UNSUPPORTED:
+    if (read) {
+      uint16_t id = wiiData[0] << 8 | wiiData[5];
+      if (!success || !verifyData(wiiData, 6) || id != wiiUnsupportedID) {
+        wiiRetry();
+      }
+      return;
+    }
+    if ((long)(millis() - wiiRetryMillis) < 0) return;
+    wiiRetryMillis = millis() + WII_UNSUPPORTED_CHECK_MS;
+    wiiQueueRead(0xFA, 6, wiiData);
     return;
   }
-  if (readFunction) readFunction(controller, data);
 }
-bool readWiiButton(Pin_t pin) {
-  uint8_t idx = wiiButtonBindings[pin.offset];
-  if (idx == INVALID_PIN) return false;
-  return !!bit_check(buttons, idx);
+// Buttons are moved into place with one mask and shift for each distance that
+// a button needs to move, instead of one button at a time.
+typedef struct {
+  uint16_t mask;
+  int8_t shift;
+} WiiButtonShift_t;
+WiiButtonShift_t wiiButtonShifts[XBOX_BTN_COUNT];
+uint8_t wiiButtonShiftCount;
+uint16_t readWiiButtons(void) {
+  uint16_t ret = 0;
+  WiiButtonShift_t *shift = wiiButtonShifts;
+  for (uint8_t i = 0; i < wiiButtonShiftCount; i++, shift++) {
+    if (shift->shift >= 0) {
+      ret |= (buttons & shift->mask) << shift->shift;
+    } else {
+      ret |= (buttons & shift->mask) >> -shift->shift;
+    }
+  }
+  return ret;
 }
 void initWiiExtensions(Configuration_t *config) {
+  wiiButtonShiftCount = 0;
+  for (uint8_t i = 0; i < XBOX_BTN_COUNT; i++) {
+    uint8_t idx = wiiButtonBindings[i];
+    if (idx == INVALID_PIN) continue;
+    int8_t distance = i - idx;
+    uint8_t j = 0;
+    while (j < wiiButtonShiftCount && wiiButtonShifts[j].shift != distance) {
+      j++;
+    }
+    if (j == wiiButtonShiftCount) {
+      wiiButtonShifts[wiiButtonShiftCount++] = (WiiButtonShift_t){0, distance};
+    }
+    bit_set(wiiButtonShifts[j].mask, idx);
+  }
   mapNunchukAccelToRightJoy = config->main.mapNunchukAccelToRightJoy;
+  wiiState = WII_CONNECT;
+  wiiBackoff = WII_BACKOFF_MIN_MS;
+  wiiRetryMillis = millis();
+  twi_addDevice(&wiiDevice, I2C_ADDR, WII_READ_DELAY_US, WII_PRIORITY,
+                WII_INTERVAL_US);
 }
\ No newline at end of file
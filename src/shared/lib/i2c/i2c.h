@@ -39,6 +39,7 @@
 
 void twi_init(void);
 void twi_disable(void);
+void twi_setFrequency(uint32_t frequency);
 bool twi_readFrom(uint8_t, uint8_t *, uint8_t, uint8_t);
 bool twi_writeTo(uint8_t, uint8_t *, uint8_t, uint8_t, uint8_t);
 bool twi_readFromPointer(uint8_t address, uint8_t pointer, uint8_t length,
@@ -50,4 +51,54 @@ bool twi_writeSingleToPointer(uint8_t address, uint8_t pointer, uint8_t data);
 bool twi_writeToPointer(uint8_t address, uint8_t pointer, uint8_t length,
                         uint8_t *data);
 
+// Reads that run in the background, from the TWI interrupt. Each one writes a
+// pointer, waits delayMicros for the device to get the data ready, and then
+// reads length bytes into data.
+// The pico reads straight out of the hardware FIFO
+#define TWI_QUEUE_MAX_READ 16
+typedef struct {
+  uint8_t address;
+  uint8_t pointer;
+  uint8_t length;
+  uint8_t *data;
+  uint16_t delayMicros;
+} TwiTransaction_t;
+// Every device on the bus has at most one read waiting at a time. When the bus
+// frees up, the waiting read with the lowest priority value goes next, so a
+// slow device can hold up a faster one by at most one read.
+// twi_startSample returns true once intervalMicros has passed since the last
+// time it did, so that each driver can limit how often it reads.
+// pending is set until the read finishes, and then done and success are set
+// from the interrupt. The driver clears done once it has used the data.
+#ifndef TWI_MAX_DEVICES
+#  define TWI_MAX_DEVICES 4
+#endif
+typedef struct {
+  TwiTransaction_t transaction;
+  uint8_t priority;
+  uint16_t intervalMicros;
+  unsigned long lastStart;
+  // When the last successful read finished
+  volatile unsigned long lastSample;
+  volatile bool sampled;
+  volatile bool pending;
+  volatile bool done;
+  volatile bool success;
+} TwiDevice_t;
+void twi_addDevice(TwiDevice_t *device, uint8_t address, uint16_t delayMicros,
+                   uint8_t priority, uint16_t intervalMicros);
+bool twi_startSample(TwiDevice_t *device);
+// Returns false if the device already has a read waiting
+bool twi_scheduleRead(TwiDevice_t *device, uint8_t pointer, uint8_t length,
+                      uint8_t *data);
+bool twi_queueBusy(void);
+// Milliseconds since each device last read something, for the config tool.
+// Writes the address and age of each device, and returns how many there are.
+#define TWI_AGE_UNKNOWN 0xFFFF
+uint8_t twi_getSampleAges(uint8_t *addresses, uint16_t *ages);
+// Implemented by each platform. twi_startTransaction begins the transaction,
+// and the platform calls twi_finishTransaction once it is done.
+void twi_startTransaction(TwiTransaction_t *transaction);
+void twi_finishTransaction(bool success);
+
 #endif
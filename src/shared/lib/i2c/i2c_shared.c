@@ -22,4 +22,105 @@ bool twi_writeToPointer(uint8_t address, uint8_t pointer, uint8_t length,
   memcpy(data2 + 1, data, length);
 
   return twi_writeTo(address, data2, length + 1, true, true);
-}
\ No newline at end of file
+}
+// The queue is used from the input core, while the interrupt that finishes
+// each read may be on the other core on the pico, where cli only masks this
+// core, so a spin lock is needed there.
+#ifdef __AVR__
+#  define TWI_LOCK()                                                           \
+    uint8_t twiSavedSREG = SREG;                                               \
+    cli()
+#  define TWI_UNLOCK() SREG = twiSavedSREG
+#else
+spin_lock_t *twi_lock;
+#  define TWI_LOCK() uint32_t twiSavedIRQ = spin_lock_blocking(twi_lock)
+#  define TWI_UNLOCK() spin_unlock(twi_lock, twiSavedIRQ)
+#endif
+TwiDevice_t *twi_devices[TWI_MAX_DEVICES];
+uint8_t twi_deviceCount;
+// The device whose read is on the bus
+TwiDevice_t *volatile twi_current;
+void twi_addDevice(TwiDevice_t *device, uint8_t address, uint16_t delayMicros,
+                   uint8_t priority, uint16_t intervalMicros) {
+#ifndef __AVR__
+  if (!twi_lock) { twi_lock = spin_lock_init(spin_lock_claim_unused(true)); }
+#endif
+  device->transaction.address = address;
+  device->transaction.delayMicros = delayMicros;
+  device->priority = priority;
+  device->intervalMicros = intervalMicros;
+  device->lastStart = micros() - intervalMicros;
+  device->sampled = false;
+  device->pending = false;
+  device->done = false;
+  for (uint8_t i = 0; i < twi_deviceCount; i++) {
+    if (twi_devices[i] == device) return;
+  }
+  if (twi_deviceCount < TWI_MAX_DEVICES) {
+    twi_devices[twi_deviceCount++] = device;
+  }
+}
+bool twi_startSample(TwiDevice_t *device) {
+  if (device->pending) return false;
+  unsigned long now = micros();
+  if (now - device->lastStart < device->intervalMicros) return false;
+  device->lastStart = now;
+  return true;
+}
+bool twi_scheduleRead(TwiDevice_t *device, uint8_t pointer, uint8_t length,
+                      uint8_t *data) {
+  if (length == 0 || length > TWI_QUEUE_MAX_READ) return false;
+  TWI_LOCK();
+  if (device->pending) {
+    TWI_UNLOCK();
+    return false;
+  }
+  device->transaction.pointer = pointer;
+  device->transaction.length = length;
+  device->transaction.data = data;
+  device->done = false;
+  device->pending = true;
+  bool start = !twi_current;
+  if (start) { twi_current = device; }
+  TWI_UNLOCK();
+  // Otherwise, the interrupt starts it once the bus is free
+  if (start) { twi_startTransaction(&device->transaction); }
+  return true;
+}
+bool twi_queueBusy(void) { return twi_current != NULL; }
+void twi_finishTransaction(bool success) {
+  // Picking the next read has to happen together with twi_scheduleRead
+  // checking twi_current, or a read scheduled in between would never start
+  TWI_LOCK();
+  TwiDevice_t *device = twi_current;
+  if (success) {
+    device->lastSample = micros();
+    device->sampled = true;
+  }
+  device->success = success;
+  device->pending = false;
+  device->done = true;
+  TwiDevice_t *next = NULL;
+  for (uint8_t i = 0; i < twi_deviceCount; i++) {
+    TwiDevice_t *waiting = twi_devices[i];
+    if (waiting->pending && (!next || waiting->priority < next->priority)) {
+      next = waiting;
+    }
+  }
+  twi_current = next;
+  TWI_UNLOCK();
+  if (next) { twi_startTransaction(&next->transaction); }
+}
+uint8_t twi_getSampleAges(uint8_t *addresses, uint16_t *ages) {
+  for (uint8_t i = 0; i < twi_deviceCount; i++) {
+    TwiDevice_t *device = twi_devices[i];
+    addresses[i] = device->transaction.address;
+    ages[i] = TWI_AGE_UNKNOWN;
+    TWI_LOCK();
+    unsigned long age = (micros() - device->lastSample) / 1000;
+    bool sampled = device->sampled;
+    TWI_UNLOCK();
+    if (sampled && age < TWI_AGE_UNKNOWN) { ages[i] = age; }
+  }
+  return twi_deviceCount;
+}
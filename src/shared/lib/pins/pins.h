@@ -32,9 +32,17 @@ typedef struct {
   uint8_t analogOffset;
 } Pin_t;
 #endif
+// Pins from MUX_PIN_BASE up are the inputs of an analog multiplexer (CD4051
+// or CD4067), instead of real pins.
+#define MUX_PIN_BASE 0x80
+#define MUX_CHANNELS 16
+#define isMuxPin(pin) ((pin) >= MUX_PIN_BASE && (pin) < MUX_PIN_BASE + MUX_CHANNELS)
+#define MAX_ANALOG_INPUTS (NUM_ANALOG_INPUTS + MUX_CHANNELS)
 typedef struct {
   uint8_t offset;
   uint8_t pin;
+  // The multiplexer input to select before reading pin, or INVALID_PIN
+  uint8_t muxChannel;
   bool inverted;
   volatile int16_t value;
   uint16_t threshold;
@@ -42,12 +50,16 @@ typedef struct {
   bool hasDigital;
 } AnalogInfo_t;
 
-extern AnalogInfo_t joyData[NUM_ANALOG_INPUTS];
+extern AnalogInfo_t joyData[MAX_ANALOG_INPUTS];
 extern int validAnalog;
 #define LOW 0
 #define CHANGE 1
 #define FALLING 2
 #define RISING 3
+// Call handler from an interrupt whenever pin sees an edge matching mode.
+// Returns false if the pin can't raise an interrupt.
+bool attachInterrupt(uint8_t pin, void (*handler)(void), uint8_t mode);
+void detachInterrupt(uint8_t pin);
 void setUpAnalogPin(Configuration_t* config, uint8_t pin);
 bool digitalRead(uint8_t pin);
 bool digitalReadPin(Pin_t pin);
@@ -57,7 +69,27 @@ void tickAnalog(void);
 uint16_t analogRead(uint8_t pin);
 void stopReading(void);
 void setUpValidPins(Configuration_t* config);
+void setUpMux(Configuration_t* config);
 void setUpAnalogDigitalPin(Pin_t* button, uint8_t pin, uint16_t threshold);
 Pin_t setUpDigital(Configuration_t* config, uint8_t pin, uint8_t offset, bool inverted, bool output);
 void digitalWritePin(Pin_t pin, bool value);
-void digitalWrite(uint8_t pin, uint8_t value);
\ No newline at end of file
+void digitalWrite(uint8_t pin, uint8_t value);
+// Read a group of digital pins together. Each port is only read once, and the
+// result has the bit for pin.offset set when that pin is pressed.
+void setUpPortScan(Pin_t *pins, uint8_t count);
+uint16_t readPortScan(void);
+// Pin detection. Every pin that isn't skipped is set to INPUT_PULLUP and read
+// at the same time, and findChangedPin returns the first pin that has changed
+// since then, or INVALID_PIN if none have.
+void startPinDetection(bool (*skip)(uint8_t pin));
+uint8_t findChangedPin(void);
+void stopPinDetection(void);
+#ifndef __AVR__
+// The pico can also sample the pins from setUpPortScan in the background, at
+// a fixed rate. readPortSample returns each sample in order, along with the
+// time it was taken.
+#  define PORT_SAMPLE_US 125
+bool startPortSampler(void);
+bool readPortSample(uint16_t *buttons, unsigned long *ms,
+                    unsigned long *us);
+#endif
\ No newline at end of file
@@ -2,6 +2,25 @@
 #include <stdint.h>
 #include <stdbool.h>
 void spi_begin(uint32_t clock, bool cpol, bool cpha, bool lsbfirst);
+// Switch the clock polarity and phase, keeping the clock and bit order
+void spi_setMode(bool cpol, bool cpha);
 uint8_t spi_transfer(uint8_t data);
 void spi_high(void);
-void spi_low(void);
\ No newline at end of file
+void spi_low(void);
+#ifndef __AVR__
+// PlayStation controllers are driven by their own PIO program, which sends a
+// whole frame and reads the reply back with DMA, without the CPU.
+// psx_start sends out, padded with zeros up to length bytes, and reads the
+// reply into in. psx_busy returns true until the frame is done, and then
+// psx_ok says if the controller kept up with the whole frame.
+#  define PSX_MAX_FRAME 36
+bool psx_init(void);
+bool psx_start(const uint8_t *out, uint8_t outLength, uint8_t *in,
+               uint8_t length);
+bool psx_busy(void);
+bool psx_ok(void);
+// Returns true if the controller has pulled ACK low since the last call
+bool psx_ackSeen(void);
+// The longest to wait for ACK after each byte, in microseconds
+void psx_setAckTimeout(uint8_t timeout);
+#endif
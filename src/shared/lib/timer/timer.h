@@ -5,6 +5,11 @@ unsigned long micros(void);
 #if __AVR__
 #  include <util/delay.h>
 #else
+#  include <pico/time.h>
+// Alarms and timers used by the inputs. The default pool's IRQ runs on core 0,
+// so core 1 makes its own pool before setting up the inputs.
+extern alarm_pool_t *inputAlarmPool;
+void setupInputAlarmPool(void);
 void _delay_ms(uint32_t __ms);
 void _delay_us(uint32_t __us);
 #endif
\ No newline at end of file
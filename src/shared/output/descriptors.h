@@ -54,9 +54,12 @@ void Endpoint_Write_Control_Stream_LE(const void *const Buffer,
 /** Endpoint address of the DEVICE IN endpoint. */
 #define MIDI_EPADDR_IN (ENDPOINT_DIR_IN | 3)
 /** Endpoint address of the DEVICE OUT endpoint. */
-#define XINPUT_2_EPADDR_IN (ENDPOINT_DIR_IN | 2)
-#define XINPUT_3_EPADDR_IN (ENDPOINT_DIR_IN | 3)
-#define XINPUT_4_EPADDR_IN (ENDPOINT_DIR_IN | 4)
+// The multi adaptor has no midi, so the other players start from its endpoint.
+// Its HID interface has no endpoints either, so the fourth player takes the HID
+// endpoint, which keeps every player within the four endpoints of the 16u2.
+#define XINPUT_2_EPADDR_IN (ENDPOINT_DIR_IN | 3)
+#define XINPUT_3_EPADDR_IN (ENDPOINT_DIR_IN | 4)
+#define XINPUT_4_EPADDR_IN HID_EPADDR_IN
 /** Endpoint address of the DEVICE IN endpoint. */
 // We don't actually utilise the next descriptors, and since the UNO limits
 // us to 4 endpoints, putting them last ensures that they are the unusable
@@ -64,7 +67,13 @@ void Endpoint_Write_Control_Stream_LE(const void *const Buffer,
 /** Endpoint address of the DEVICE OUT endpoint.*/
 /** Endpoint address of the DEVICE OUT endpoint.  */
 #define HID_EPADDR_OUT (ENDPOINT_DIR_OUT | 6)
-#define XINPUT_EPADDR_OUT (ENDPOINT_DIR_OUT | 7)
+// Rumble comes in on the XInput OUT endpoint, so it needs one that the 32u4
+// actually has. The multi adaptor uses 4 for another player.
+#ifdef MULTI_ADAPTOR
+#  define XINPUT_EPADDR_OUT (ENDPOINT_DIR_OUT | 7)
+#else
+#  define XINPUT_EPADDR_OUT (ENDPOINT_DIR_OUT | 4)
+#endif
 #define MIDI_EPADDR_OUT (ENDPOINT_DIR_OUT | 8)
 #define XINPUT_2_EPADDR_OUT (ENDPOINT_DIR_OUT | 9)
 #define XINPUT_3_EPADDR_OUT (ENDPOINT_DIR_OUT | 10)
@@ -168,6 +177,7 @@ typedef struct {
   USB_OSCompatibleSection_t CompatID2;
   USB_OSCompatibleSection_t CompatID3;
   USB_OSCompatibleSection_t CompatID4;
+  USB_OSCompatibleSection_t CompatID5;
 } ATTR_PACKED USB_OSCompatibleIDDescriptor_4_t;
 typedef struct {
   uint32_t TotalLength;
@@ -7,4 +7,8 @@
 
 extern void (*fillReport)(void *ReportData, uint8_t *const ReportSize,
                           Controller_t *controller);
-void initReports(Configuration_t* config);
\ No newline at end of file
+void initReports(Configuration_t* config);
+// The motor speeds from the last rumble report that the host sent
+extern uint8_t rumbleLarge;
+extern uint8_t rumbleSmall;
+void processXInputOutReport(const uint8_t *data, uint8_t len);
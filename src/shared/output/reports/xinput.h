@@ -14,4 +14,14 @@ void fillXInputReport(void *ReportData, uint8_t *const ReportSize,
   JoystickReport->rsize = sizeof(USB_XInputReport_Data_t);
   // Don't copy the led info tagged on the end
   memcpy(&JoystickReport->buttons, controller, sizeof(XInput_Data_t));
-}
\ No newline at end of file
+}
+// The host sends rumble as 00 08 00 large small 00 00 00, and the ring of LEDs
+// as 01 03 pattern, which isn't used.
+#define XINPUT_RUMBLE_REPORT 0x00
+uint8_t rumbleLarge;
+uint8_t rumbleSmall;
+void processXInputOutReport(const uint8_t *data, uint8_t len) {
+  if (len < 5 || data[0] != XINPUT_RUMBLE_REPORT) return;
+  rumbleLarge = data[3];
+  rumbleSmall = data[4];
+}
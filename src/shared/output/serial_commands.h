@@ -18,6 +18,13 @@ enum SerialCommands {
     COMMAND_READ_CONFIG,
     MAX
 };
+// Everything from COMMAND_READ_CONFIG up is used for reading the config, so
+// newer commands have to go below COMMAND_REBOOT
+enum ExtraSerialCommands {
+    COMMAND_GET_FILTER_DELAY=0x20,
+    COMMAND_GET_LAST_EDGE,
+    COMMAND_GET_I2C_AGES,
+};
 typedef struct {
     uint32_t cpu_freq;
     bool multi;
@@ -2,6 +2,7 @@
 #include "avr-nrf24l01/src/nrf24l01-mnemonics.h"
 #include "avr-nrf24l01/src/nrf24l01.h"
 #include "controller/controller.h"
+#include "i2c/i2c.h"
 #include "leds/leds.h"
 #include "rf/rf.h"
 #include "serial_commands.h"
@@ -115,6 +116,25 @@ void processHIDReadFeatureReport(uint8_t cmd, uint8_t report, const void* reques
     } else if (inputType == PS2) {
       dbuf[1] = ps2CtrlType;
     }
+  } else if (cmd == COMMAND_GET_FILTER_DELAY) {
+    // dbuf + 1 isn't aligned for a uint16_t, so each delay is copied in
+    for (uint8_t i = 0; i < XBOX_AXIS_COUNT; i++) {
+      uint16_t delay = getFilterDelay(i);
+      memcpy(dbuf + 1 + i * sizeof(delay), &delay, sizeof(delay));
+    }
+    size = sizeof(uint16_t) * XBOX_AXIS_COUNT + 1;
+  } else if (cmd == COMMAND_GET_LAST_EDGE) {
+    memcpy(dbuf + 1, &lastEdgeButtons, sizeof(lastEdgeButtons));
+    memcpy(dbuf + 3, &lastEdgeMicros, sizeof(lastEdgeMicros));
+    size = sizeof(lastEdgeButtons) + sizeof(lastEdgeMicros) + 1;
+  } else if (cmd == COMMAND_GET_I2C_AGES) {
+    // The number of devices, then each address, then each age
+    uint8_t *addresses = dbuf + 2;
+    uint16_t ages[TWI_MAX_DEVICES];
+    uint8_t count = twi_getSampleAges(addresses, ages);
+    dbuf[1] = count;
+    memcpy(addresses + count, ages, sizeof(uint16_t) * count);
+    size = 2 + count * (1 + sizeof(uint16_t));
   } else if (cmd == COMMAND_GET_FOUND) {
     size = 2;
     dbuf[1] = detectedPin;
@@ -0,0 +1,43 @@
+// Checks that every input looked up through the axis tables lands within
+// AXIS_LUT_MAX_ERROR of the exact scaled value. Built for the host, see
+// test/CMakeLists.txt.
+#include "input/axis_lut.h"
+#include <stdio.h>
+
+static const int16_t multipliers[] = {1024, 1100, 1300, 1536, 2048, 3000, 4096, 9000};
+static const int16_t offsets[] = {INT16_MIN, INT16_MIN + 3000, -20000, -12345, 0, 5000};
+static const uint8_t curves[] = {CURVE_LINEAR, CURVE_EXPONENTIAL, CURVE_S};
+static const char *curveNames[] = {"linear", "exponential", "s"};
+
+int main(void) {
+  int failures = 0;
+  for (uint8_t c = 0; c < sizeof(curves); c++) {
+    for (uint8_t m = 0; m < sizeof(multipliers) / sizeof(*multipliers); m++) {
+      for (uint8_t o = 0; o < sizeof(offsets) / sizeof(*offsets); o++) {
+        for (uint8_t unipolar = 0; unipolar < 2; unipolar++) {
+          AxisScale_t scale = {multipliers[m], offsets[o], 0};
+          initAxisLUT(0, &scale, curves[c], unipolar);
+          int32_t worst = 0;
+          int32_t worstInput = 0;
+          for (int32_t x = INT16_MIN; x <= INT16_MAX; x++) {
+            int32_t error = (int32_t)lookupAxis(0, x) -
+                            scaleAxisExact(&axisLUTs[0], x);
+            if (error < 0) error = -error;
+            if (error > worst) {
+              worst = error;
+              worstInput = x;
+            }
+          }
+          if (worst > AXIS_LUT_MAX_ERROR) {
+            printf("FAIL %s multiplier %d offset %d %s: off by %d at %d\n",
+                   curveNames[c], scale.multiplier, scale.offset,
+                   unipolar ? "unipolar" : "bipolar", worst, worstInput);
+            failures++;
+          }
+        }
+      }
+    }
+  }
+  printf("%d failures with %d knots\n", failures, AXIS_LUT_SEGMENTS + 1);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+// util.h pulls this in on anything that isn't an avr. The tests only need
+// the pure code, so there is nothing to stub here.